@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+# Consistency checks of a merged EDM4hep timeframe file for the CI pipeline
+# Usage: check_timeframes.py <file> --entries N [--unique-event-numbers] [--sorted] [--window T_MIN T_MAX] [--unique-cells]
+#
+# Always checks the entry count and that every ObjectID reference and calorimeter
+# contribution range points inside its collection. Options:
+#   --unique-event-numbers  EventHeader.eventNumber differs between all timeframes
+#   --sorted                Tracker hits and calorimeter contributions are in time order
+#   --window T_MIN T_MAX    Tracker hit and calorimeter contribution times lie in the window
+#   --unique-cells          Every calorimeter cell has at most one hit per timeframe (pile-up combined)
+
+import argparse
+import sys
+
+import ROOT
+
+
+def branch_class(tree, name):
+    branch = tree.GetBranch(name)
+    return branch.GetClassName() if branch else ""
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("file")
+    parser.add_argument("--entries", type=int, required=True)
+    parser.add_argument("--unique-event-numbers", action="store_true")
+    parser.add_argument("--sorted", action="store_true")
+    parser.add_argument("--window", type=float, nargs=2, metavar=("T_MIN", "T_MAX"))
+    parser.add_argument("--unique-cells", action="store_true")
+    args = parser.parse_args()
+
+    errors = []
+    root_file = ROOT.TFile.Open(args.file)
+    tree = root_file.Get("events")
+    if tree.GetEntries() != args.entries:
+        errors.append(f"{tree.GetEntries()} entries, expected {args.entries}")
+
+    branches = [branch.GetName() for branch in tree.GetListOfBranches()]
+    tracker = [name for name in branches if "SimTrackerHitData" in branch_class(tree, name)]
+    calo = [name for name in branches if "SimCalorimeterHitData" in branch_class(tree, name)]
+
+    event_numbers = []
+    for entry in range(tree.GetEntries()):
+        tree.GetEntry(entry)
+        event_numbers.append(getattr(tree, "EventHeader")[0].eventNumber)
+        n_particles = getattr(tree, "MCParticles").size()
+
+        def check_time_order(label, times):
+            if args.sorted and any(later < earlier for earlier, later in zip(times, times[1:])):
+                errors.append(f"entry {entry}: {label} not sorted by time")
+            if args.window and any(t < args.window[0] or t > args.window[1] for t in times):
+                errors.append(f"entry {entry}: {label} outside the time window")
+
+        # Negative indices are unset references
+        def check_refs(label, refs, size):
+            if any(ref.index >= size for ref in refs):
+                errors.append(f"entry {entry}: {label} references beyond {size} elements")
+
+        for name in tracker:
+            hits = getattr(tree, name)
+            check_refs(f"_{name}_particle", getattr(tree, f"_{name}_particle"), n_particles)
+            check_time_order(name, [hit.time for hit in hits])
+
+        for name in calo:
+            hits = getattr(tree, name)
+            contribution_refs = getattr(tree, f"_{name}_contributions")
+            contributions = getattr(tree, f"{name}Contributions")
+            for hit in hits:
+                if hit.contributions_begin > hit.contributions_end or hit.contributions_end > contribution_refs.size():
+                    errors.append(f"entry {entry}: {name} contribution range outside the references")
+                    break
+            if args.unique_cells and len({hit.cellID for hit in hits}) != hits.size():
+                errors.append(f"entry {entry}: {name} has several hits in one cell")
+            check_refs(f"_{name}_contributions", contribution_refs, contributions.size())
+            check_refs(f"_{name}Contributions_particle", getattr(tree, f"_{name}Contributions_particle"), n_particles)
+            check_time_order(f"{name}Contributions", [contribution.time for contribution in contributions])
+
+    if args.unique_event_numbers and len(set(event_numbers)) != len(event_numbers):
+        errors.append("EventHeader.eventNumber is not unique")
+
+    for error in errors[:50]:
+        print(f"ERROR: {error}")
+    if errors:
+        return 1
+    print(f"{args.file}: {tree.GetEntries()} timeframes, {len(tracker)} tracker and {len(calo)} calorimeter collections OK")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
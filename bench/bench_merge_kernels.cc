@@ -0,0 +1,498 @@
+// bench_merge_kernels.cc - Micro-benchmarks for the merge kernels and source reading
+//
+// Writes a synthetic EDM4hep input file at realistic sizes, opens it through the
+// regular EDM4hepDataHandler/EDM4hepDataSource path and times the hot kernels one
+// at a time. Results are reported as ns/event and GB/s so they can be compared
+// across commits (use --csv to keep a machine readable copy).
+#include "EDM4hepDataHandler.h"
+#include "EDM4hepDataSource.h"
+#ifdef HAVE_HEPMC3
+#include "HepMC3DataHandler.h"
+#endif
+#include <TFile.h>
+#include <TTree.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <getopt.h>
+
+namespace {
+
+struct BenchOptions {
+    size_t entries{200};              // Synthetic entries written to the input file
+    size_t iterations{2000};          // Timed calls per kernel
+    size_t events_per_frame{100};     // Appends before the merged collections are cleared
+    size_t particles{500};            // MCParticles per event
+    size_t tracker_collections{20};
+    size_t tracker_hits{40};          // Hits per tracker collection per event
+    size_t calo_collections{10};
+    size_t calo_hits{100};            // Hits per calorimeter collection per event
+    size_t contributions{4};          // Contributions per calorimeter hit
+    size_t hepmc3_particles{1000};    // Particles per synthetic HepMC3 event
+    std::string csv_file;
+    std::string input_file{"timeframe_bench_input.edm4hep.root"};
+    std::string output_file{"timeframe_bench_output.edm4hep.root"};
+    bool keep_files{false};
+};
+
+struct BenchResult {
+    std::string kernel;
+    size_t calls;
+    double ns_per_event;
+    double gb_per_s;
+};
+
+// Expose the protected per-event merge step of the EDM4hep handler
+class BenchEDM4hepDataHandler : public EDM4hepDataHandler {
+public:
+    using EDM4hepDataHandler::processEvent;
+};
+
+#ifdef HAVE_HEPMC3
+// Expose the protected HepMC3 sub-event append
+class BenchHepMC3DataHandler : public HepMC3DataHandler {
+public:
+    using HepMC3DataHandler::appendHepMC3Event;
+};
+#endif
+
+std::string trackerName(size_t i) { return "BenchTracker" + std::to_string(i) + "Hits"; }
+std::string caloName(size_t i) { return "BenchCalo" + std::to_string(i) + "Hits"; }
+
+/**
+ * Time a kernel. setup() runs outside the timed region before every call.
+ * @param calls_per_iteration Number of events processed by one kernel() call
+ * @param bytes_per_event Payload touched per event, used for the GB/s figure
+ */
+template <typename Setup, typename Kernel>
+BenchResult runKernel(const std::string& name, size_t iterations, size_t calls_per_iteration,
+                      size_t bytes_per_event, Setup&& setup, Kernel&& kernel) {
+    using clock = std::chrono::steady_clock;
+
+    // Warm up caches and allocator state
+    size_t warmup = std::min<size_t>(iterations / 10 + 1, 100);
+    for (size_t i = 0; i < warmup; ++i) {
+        setup(i);
+        kernel(i);
+    }
+
+    std::chrono::nanoseconds total{0};
+    for (size_t i = 0; i < iterations; ++i) {
+        setup(i);
+        auto start = clock::now();
+        kernel(i);
+        total += clock::now() - start;
+    }
+
+    double calls = static_cast<double>(iterations * calls_per_iteration);
+    double ns_per_event = static_cast<double>(total.count()) / calls;
+    // bytes per ns is numerically GB/s
+    double gb_per_s = ns_per_event > 0.0 ? static_cast<double>(bytes_per_event) / ns_per_event : 0.0;
+    return {name, iterations * calls_per_iteration, ns_per_event, gb_per_s};
+}
+
+size_t eventPayloadBytes(const BenchOptions& opt) {
+    size_t particles = opt.particles * sizeof(edm4hep::MCParticleData)
+                     + 2 * opt.particles * sizeof(podio::ObjectID);
+    size_t tracker = opt.tracker_collections * opt.tracker_hits
+                   * (sizeof(edm4hep::SimTrackerHitData) + sizeof(podio::ObjectID));
+    size_t n_contribs = opt.calo_hits * opt.contributions;
+    size_t calo = opt.calo_collections
+                * (opt.calo_hits * sizeof(edm4hep::SimCalorimeterHitData)
+                   + n_contribs * (2 * sizeof(podio::ObjectID) + sizeof(edm4hep::CaloHitContributionData)));
+    return particles + tracker + calo;
+}
+
+void writeSyntheticInput(const BenchOptions& opt) {
+    std::cout << "Writing synthetic input: " << opt.input_file << " (" << opt.entries << " entries)" << std::endl;
+
+    TFile file(opt.input_file.c_str(), "RECREATE");
+    if (file.IsZombie()) {
+        throw std::runtime_error("Could not create synthetic input file: " + opt.input_file);
+    }
+    auto* tree = new TTree("events", "Synthetic events for timeframe_bench");
+
+    std::vector<edm4hep::EventHeaderData> headers;
+    std::vector<edm4hep::MCParticleData> particles;
+    std::vector<podio::ObjectID> parents;
+    std::vector<podio::ObjectID> daughters;
+    std::vector<std::vector<edm4hep::SimTrackerHitData>> tracker_hits(opt.tracker_collections);
+    std::vector<std::vector<podio::ObjectID>> tracker_refs(opt.tracker_collections);
+    std::vector<std::vector<edm4hep::SimCalorimeterHitData>> calo_hits(opt.calo_collections);
+    std::vector<std::vector<podio::ObjectID>> calo_hit_refs(opt.calo_collections);
+    std::vector<std::vector<edm4hep::CaloHitContributionData>> contribs(opt.calo_collections);
+    std::vector<std::vector<podio::ObjectID>> contrib_refs(opt.calo_collections);
+    std::vector<std::vector<int>> gp_int;
+    std::vector<std::vector<float>> gp_float;
+    std::vector<std::vector<double>> gp_double;
+    std::vector<std::vector<std::string>> gp_string;
+
+    tree->Branch("EventHeader", &headers);
+    tree->Branch("MCParticles", &particles);
+    tree->Branch("_MCParticles_parents", &parents);
+    tree->Branch("_MCParticles_daughters", &daughters);
+    for (size_t c = 0; c < opt.tracker_collections; ++c) {
+        std::string name = trackerName(c);
+        tree->Branch(name.c_str(), &tracker_hits[c]);
+        tree->Branch(("_" + name + "_particle").c_str(), &tracker_refs[c]);
+    }
+    for (size_t c = 0; c < opt.calo_collections; ++c) {
+        std::string name = caloName(c);
+        tree->Branch(name.c_str(), &calo_hits[c]);
+        tree->Branch(("_" + name + "_contributions").c_str(), &calo_hit_refs[c]);
+        tree->Branch((name + "Contributions").c_str(), &contribs[c]);
+        tree->Branch(("_" + name + "Contributions_particle").c_str(), &contrib_refs[c]);
+    }
+    tree->Branch("GPIntValues", &gp_int);
+    tree->Branch("GPFloatValues", &gp_float);
+    tree->Branch("GPDoubleValues", &gp_double);
+    tree->Branch("GPStringValues", &gp_string);
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> time_dist(0.0f, 50.0f);
+    std::uniform_real_distribution<float> pos_dist(-1000.0f, 1000.0f);
+    std::uniform_int_distribution<int> particle_dist(0, static_cast<int>(opt.particles) - 1);
+    std::uniform_int_distribution<uint64_t> cell_dist(0, 1u << 30);
+
+    for (size_t entry = 0; entry < opt.entries; ++entry) {
+        headers.assign(1, edm4hep::EventHeaderData{});
+        headers[0].eventNumber = static_cast<int32_t>(entry);
+
+        // Simple decay chain: particle k has parent k-1 and daughter k+1
+        particles.clear();
+        parents.clear();
+        daughters.clear();
+        for (size_t k = 0; k < opt.particles; ++k) {
+            edm4hep::MCParticleData particle{};
+            particle.PDG = 211;
+            particle.generatorStatus = k < 2 ? 4 : 1;
+            particle.time = time_dist(rng);
+            particle.vertex.x = pos_dist(rng);
+            particle.vertex.y = pos_dist(rng);
+            particle.vertex.z = pos_dist(rng);
+            particle.parents_begin = parents.size();
+            if (k > 0) parents.push_back({static_cast<int>(k - 1), 1});
+            particle.parents_end = parents.size();
+            particle.daughters_begin = daughters.size();
+            if (k + 1 < opt.particles) daughters.push_back({static_cast<int>(k + 1), 1});
+            particle.daughters_end = daughters.size();
+            particles.push_back(particle);
+        }
+
+        for (size_t c = 0; c < opt.tracker_collections; ++c) {
+            tracker_hits[c].clear();
+            tracker_refs[c].clear();
+            for (size_t h = 0; h < opt.tracker_hits; ++h) {
+                edm4hep::SimTrackerHitData hit{};
+                hit.cellID = cell_dist(rng);
+                hit.time = time_dist(rng);
+                hit.eDep = 1e-4f;
+                tracker_hits[c].push_back(hit);
+                tracker_refs[c].push_back({particle_dist(rng), 1});
+            }
+        }
+
+        for (size_t c = 0; c < opt.calo_collections; ++c) {
+            calo_hits[c].clear();
+            calo_hit_refs[c].clear();
+            contribs[c].clear();
+            contrib_refs[c].clear();
+            for (size_t h = 0; h < opt.calo_hits; ++h) {
+                edm4hep::SimCalorimeterHitData hit{};
+                hit.cellID = cell_dist(rng);
+                hit.contributions_begin = calo_hit_refs[c].size();
+                for (size_t k = 0; k < opt.contributions; ++k) {
+                    edm4hep::CaloHitContributionData contrib{};
+                    contrib.PDG = 22;
+                    contrib.energy = 1e-3f;
+                    contrib.time = time_dist(rng);
+                    hit.energy += contrib.energy;
+                    calo_hit_refs[c].push_back({static_cast<int>(contribs[c].size()), 2});
+                    contribs[c].push_back(contrib);
+                    contrib_refs[c].push_back({particle_dist(rng), 1});
+                }
+                hit.contributions_end = calo_hit_refs[c].size();
+                calo_hits[c].push_back(hit);
+            }
+        }
+
+        tree->Fill();
+    }
+
+    tree->Write();
+    file.Close();
+}
+
+void fillMergedCollections(EDM4hepMergedCollections& merged, const BenchOptions& opt) {
+    size_t frame = opt.events_per_frame;
+    merged.mcparticles.resize(frame * opt.particles);
+    merged.mcparticle_parents_refs.resize(frame * opt.particles);
+    merged.mcparticle_daughters_refs.resize(frame * opt.particles);
+    merged.sub_event_headers.resize(frame);
+    merged.sub_event_header_weights.resize(frame);
+    for (size_t c = 0; c < opt.tracker_collections; ++c) {
+        std::string name = trackerName(c);
+        merged.tracker_hits[name].resize(frame * opt.tracker_hits);
+        merged.tracker_hit_particle_refs[name].resize(frame * opt.tracker_hits);
+    }
+    for (size_t c = 0; c < opt.calo_collections; ++c) {
+        std::string name = caloName(c);
+        merged.calo_hits[name].resize(frame * opt.calo_hits);
+        merged.calo_hit_contributions_refs[name].resize(frame * opt.calo_hits * opt.contributions);
+        merged.calo_contributions[name].resize(frame * opt.calo_hits * opt.contributions);
+        merged.calo_contrib_particle_refs[name].resize(frame * opt.calo_hits * opt.contributions);
+    }
+}
+
+#ifdef HAVE_HEPMC3
+HepMC3::GenEventData makeSyntheticHepMC3Event(size_t n_particles) {
+    HepMC3::GenEvent event(HepMC3::Units::GEV, HepMC3::Units::MM);
+
+    // Two beams into a primary vertex, then pairs of decays from every tenth particle
+    auto primary = std::make_shared<HepMC3::GenVertex>(HepMC3::FourVector(0.1, 0.2, 5.0, 0.0));
+    primary->add_particle_in(std::make_shared<HepMC3::GenParticle>(HepMC3::FourVector(0, 0, 18.0, 18.0), 11, 4));
+    primary->add_particle_in(std::make_shared<HepMC3::GenParticle>(HepMC3::FourVector(0, 0, -275.0, 275.0), 2212, 4));
+    event.add_vertex(primary);
+
+    size_t produced = 2;
+    std::vector<HepMC3::GenParticlePtr> outgoing;
+    while (produced < n_particles) {
+        auto particle = std::make_shared<HepMC3::GenParticle>(HepMC3::FourVector(0.3, 0.1, 1.0, 1.1), 211, 1);
+        primary->add_particle_out(particle);
+        outgoing.push_back(particle);
+        ++produced;
+        if (outgoing.size() % 10 == 0 && produced + 2 <= n_particles) {
+            particle->set_status(2);
+            auto decay = std::make_shared<HepMC3::GenVertex>(HepMC3::FourVector(1.0, 1.0, 10.0, 0.1));
+            decay->add_particle_in(particle);
+            decay->add_particle_out(std::make_shared<HepMC3::GenParticle>(HepMC3::FourVector(0.1, 0.0, 0.5, 0.55), 22, 1));
+            decay->add_particle_out(std::make_shared<HepMC3::GenParticle>(HepMC3::FourVector(0.2, 0.1, 0.5, 0.55), 22, 1));
+            event.add_vertex(decay);
+            produced += 2;
+        }
+    }
+
+    // The merge works on the flat form read from the input tree
+    HepMC3::GenEventData data;
+    event.write_data(data);
+    return data;
+}
+#endif
+
+void printUsage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options]\n"
+              << "\nOptions:\n"
+              << "  --entries N                 Synthetic entries in the input file (default: 200)\n"
+              << "  --iterations N              Timed calls per kernel (default: 2000)\n"
+              << "  --events-per-frame N        Appends between clears of the merged collections (default: 100)\n"
+              << "  --particles N               MCParticles per event (default: 500)\n"
+              << "  --tracker-collections N     Tracker collections (default: 20)\n"
+              << "  --tracker-hits N            Hits per tracker collection per event (default: 40)\n"
+              << "  --calo-collections N        Calorimeter collections (default: 10)\n"
+              << "  --calo-hits N               Hits per calorimeter collection per event (default: 100)\n"
+              << "  --contributions N           Contributions per calorimeter hit (default: 4)\n"
+              << "  --hepmc3-particles N        Particles per synthetic HepMC3 event (default: 1000)\n"
+              << "  --csv FILE                  Also write the results as CSV\n"
+              << "  --keep-files                Keep the synthetic input and output files\n"
+              << "  -h, --help                  Show this help message\n";
+}
+
+BenchOptions parseOptions(int argc, char* argv[]) {
+    BenchOptions opt;
+    static struct option long_options[] = {
+        {"entries", required_argument, 0, 2000},
+        {"iterations", required_argument, 0, 2001},
+        {"events-per-frame", required_argument, 0, 2002},
+        {"particles", required_argument, 0, 2003},
+        {"tracker-collections", required_argument, 0, 2004},
+        {"tracker-hits", required_argument, 0, 2005},
+        {"calo-collections", required_argument, 0, 2006},
+        {"calo-hits", required_argument, 0, 2007},
+        {"contributions", required_argument, 0, 2008},
+        {"hepmc3-particles", required_argument, 0, 2009},
+        {"csv", required_argument, 0, 2010},
+        {"keep-files", no_argument, 0, 2011},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt_char;
+    int option_index = 0;
+    while ((opt_char = getopt_long(argc, argv, "h", long_options, &option_index)) != -1) {
+        switch (opt_char) {
+            case 2000: opt.entries = std::stoul(optarg); break;
+            case 2001: opt.iterations = std::stoul(optarg); break;
+            case 2002: opt.events_per_frame = std::stoul(optarg); break;
+            case 2003: opt.particles = std::stoul(optarg); break;
+            case 2004: opt.tracker_collections = std::stoul(optarg); break;
+            case 2005: opt.tracker_hits = std::stoul(optarg); break;
+            case 2006: opt.calo_collections = std::stoul(optarg); break;
+            case 2007: opt.calo_hits = std::stoul(optarg); break;
+            case 2008: opt.contributions = std::stoul(optarg); break;
+            case 2009: opt.hepmc3_particles = std::stoul(optarg); break;
+            case 2010: opt.csv_file = optarg; break;
+            case 2011: opt.keep_files = true; break;
+            case 'h':
+                printUsage(argv[0]);
+                std::exit(0);
+            default:
+                printUsage(argv[0]);
+                throw std::runtime_error("Invalid command-line arguments");
+        }
+    }
+
+    if (opt.entries == 0 || opt.iterations == 0 || opt.events_per_frame == 0 || opt.particles < 2) {
+        throw std::runtime_error("entries, iterations and events-per-frame must be positive and particles >= 2");
+    }
+    return opt;
+}
+
+void printResults(const std::vector<BenchResult>& results) {
+    std::cout << "\n" << std::left << std::setw(36) << "kernel"
+              << std::right << std::setw(12) << "calls"
+              << std::setw(16) << "ns/event"
+              << std::setw(12) << "GB/s" << std::endl;
+    std::cout << std::string(76, '-') << std::endl;
+    for (const auto& result : results) {
+        std::cout << std::left << std::setw(36) << result.kernel
+                  << std::right << std::setw(12) << result.calls
+                  << std::setw(16) << std::fixed << std::setprecision(1) << result.ns_per_event
+                  << std::setw(12) << std::setprecision(3) << result.gb_per_s << std::endl;
+    }
+}
+
+void writeCsv(const std::string& filename, const std::vector<BenchResult>& results) {
+    std::ofstream csv(filename);
+    if (!csv) {
+        throw std::runtime_error("Could not open CSV output: " + filename);
+    }
+    csv << "kernel,calls,ns_per_event,gb_per_s\n";
+    for (const auto& result : results) {
+        csv << result.kernel << "," << result.calls << "," << result.ns_per_event << "," << result.gb_per_s << "\n";
+    }
+    std::cout << "Results written to: " << filename << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchOptions opt = parseOptions(argc, argv);
+        writeSyntheticInput(opt);
+
+        std::vector<BenchResult> results;
+        const size_t payload_bytes = eventPayloadBytes(opt);
+
+        // Open the synthetic file through the regular handler so collection discovery,
+        // branch setup and the merge path are exactly what timeframe_builder runs
+        SourceConfig source_config;
+        source_config.name = "bench";
+        source_config.input_files = {opt.input_file};
+        source_config.repeat_on_eof = true;
+        std::vector<SourceConfig> source_configs{source_config};
+
+        BenchEDM4hepDataHandler handler;
+        auto sources = handler.initializeDataSources(opt.output_file, source_configs);
+        auto& source = dynamic_cast<EDM4hepDataSource&>(*sources[0]);
+        source.loadEvent(0);
+
+        auto no_setup = [](size_t) {};
+
+        results.push_back(runKernel("GetEntry", opt.iterations, 1, payload_bytes, no_setup,
+            [&](size_t i) { source.loadEvent(i % opt.entries); }));
+        source.loadEvent(0);
+
+        results.push_back(runKernel("processMCParticles", opt.iterations, 1,
+            opt.particles * sizeof(edm4hep::MCParticleData), no_setup,
+            [&](size_t) { source.processMCParticles(1, 1, 1); }));
+
+        results.push_back(runKernel("processObjectID", opt.iterations, 1,
+            (opt.particles - 1) * sizeof(podio::ObjectID), no_setup,
+            [&](size_t) { source.processObjectID("_MCParticles_parents", 1, 1); }));
+
+        if (opt.calo_collections > 0) {
+            const std::string calo_name = caloName(0);
+            results.push_back(runKernel("processCaloHits", opt.iterations, 1,
+                opt.calo_hits * sizeof(edm4hep::SimCalorimeterHitData), no_setup,
+                [&](size_t) { source.processCaloHits(calo_name, 1, 1); }));
+        }
+
+        // Full per-event append path; the merged collections are cleared once per frame. The
+        // entry is reloaded untimed before every event, as a first contributor swaps its buffers away
+        results.push_back(runKernel("EDM4hepDataHandler::processEvent", opt.iterations, 1, payload_bytes,
+            [&](size_t i) {
+                if (i % opt.events_per_frame == 0) handler.prepareTimeframe();
+                source.loadEvent(0);
+            },
+            [&](size_t) { handler.processEvent(source); }));
+
+        // clear() of a merged frame holding events_per_frame events
+        EDM4hepMergedCollections merged;
+        results.push_back(runKernel("EDM4hepMergedCollections::clear", opt.iterations, 1,
+            payload_bytes * opt.events_per_frame,
+            [&](size_t) { fillMergedCollections(merged, opt); },
+            [&](size_t) { merged.clear(); }));
+
+        // Time offset generation as in the merge loop (draw, then apply with the beam distance),
+        // with bunch crossing, beam attachment and spread enabled
+        SourceConfig offset_config;
+        offset_config.use_bunch_crossing = true;
+        offset_config.attach_to_beam = true;
+        offset_config.beam_spread = 0.003f;
+        EDM4hepDataSource offset_source(offset_config, 0);
+        std::mt19937 rng(42);
+        const size_t offsets_per_call = 1000;
+        float offset_sink = 0.0f;
+        results.push_back(runKernel("DataSource::UpdateTimeOffset", opt.iterations, offsets_per_call,
+            sizeof(float), no_setup,
+            [&](size_t) {
+                for (size_t k = 0; k < offsets_per_call; ++k) {
+                    const auto draw = offset_source.drawTimeOffset(2000.0f, 10.0f, rng);
+                    offset_source.UpdateTimeOffset(draw, 100.0f);
+                    offset_sink += offset_source.getCurrentTimeOffset();
+                }
+            }));
+        if (offset_sink < 0.0f) std::cout << offset_sink << std::endl; // keep the loop observable
+
+#ifdef HAVE_HEPMC3
+        BenchHepMC3DataHandler hepmc3_handler;
+        HepMC3::GenEventData hepmc3_event = makeSyntheticHepMC3Event(opt.hepmc3_particles);
+        HepMC3::GenEventData hepframe;
+        size_t hepmc3_bytes = hepmc3_event.particles.size() * sizeof(HepMC3::GenParticleData)
+                            + hepmc3_event.vertices.size() * sizeof(HepMC3::GenVertexData)
+                            + hepmc3_event.links1.size() * 2 * sizeof(int);
+        results.push_back(runKernel("HepMC3DataHandler::appendHepMC3Event", opt.iterations, 1, hepmc3_bytes,
+            [&](size_t i) {
+                if (i % opt.events_per_frame == 0) {
+                    hepframe.particles.clear();
+                    hepframe.vertices.clear();
+                    hepframe.links1.clear();
+                    hepframe.links2.clear();
+                }
+            },
+            [&](size_t) { hepmc3_handler.appendHepMC3Event(hepmc3_event, hepframe, 100.0, 1000); }));
+#endif
+
+        handler.finalize();
+
+        printResults(results);
+        if (!opt.csv_file.empty()) {
+            writeCsv(opt.csv_file, results);
+        }
+
+        if (!opt.keep_files) {
+            std::filesystem::remove(opt.input_file);
+            std::filesystem::remove(opt.output_file);
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""End-to-end throughput sweep for timeframe_builder.
+
+Runs the full timeframe_builder over a matrix of timeframe durations,
+luminosity scales (multiplier on every Poisson source's mean_event_frequency),
+number of sources, ROOT thread counts and output compression settings. Each
+run writes a JSON run report (--report); the results are collected into one
+CSV and one JSON table.
+
+Example:
+    bench/throughput_sweep.py --binary install/bin/timeframe_builder \\
+        --config configs/config_ci.yml \\
+        --input signal=epic_sim_ci_signal.edm4hep.root \\
+        --input electron_synchrotron=epic_sim_ci_electron_synchrotron.edm4hep.root \\
+        --luminosity-scales 0.5,1,2 --threads 0,4 --compression zlib:1,zstd:5
+"""
+
+import argparse
+import copy
+import csv
+import itertools
+import json
+import os
+import subprocess
+import sys
+import time
+
+import yaml
+
+STAGES = ["initialize", "sample", "prepare", "merge", "write", "finalize"]
+
+
+def parse_list(value, cast):
+    return [cast(item) for item in value.split(",") if item]
+
+
+def parse_compression(value):
+    settings = []
+    for item in value.split(","):
+        if not item:
+            continue
+        algorithm, _, level = item.partition(":")
+        settings.append((algorithm, int(level) if level else 1))
+    return settings
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--binary", default="install/bin/timeframe_builder", help="timeframe_builder executable")
+    parser.add_argument("--config", required=True, help="Base YAML configuration")
+    parser.add_argument("--input", action="append", default=[], metavar="NAME=FILE[,FILE]",
+                        help="Input files for a source of the base configuration (repeatable)")
+    parser.add_argument("--timeframes", type=int, default=20, help="Timeframes per run (default: 20)")
+    parser.add_argument("--durations", default="", help="Comma-separated timeframe durations in ns (default: from config)")
+    parser.add_argument("--luminosity-scales", default="1", help="Comma-separated multipliers on mean_event_frequency")
+    parser.add_argument("--n-sources", default="", help="Comma-separated number of sources, first N of the config (default: all)")
+    parser.add_argument("--threads", default="0", help="Comma-separated ROOT implicit MT thread counts")
+    parser.add_argument("--compression", default="zlib:1", help="Comma-separated ALG:LEVEL output compression settings")
+    parser.add_argument("--output-extension", default=".edm4hep.root", help="Output file extension (selects the format)")
+    parser.add_argument("--output-dir", default="throughput_sweep", help="Directory for per-run configs, reports and outputs")
+    parser.add_argument("--csv", default="throughput_sweep.csv", help="CSV result table")
+    parser.add_argument("--json", default="throughput_sweep.json", help="JSON result table")
+    parser.add_argument("--keep-outputs", action="store_true", help="Keep the merged output files")
+    return parser.parse_args()
+
+
+def run_builder(binary, config_file, log_file):
+    """Run one timeframe_builder and return (exit code, wall seconds, peak RSS in MB)."""
+    start = time.monotonic()
+    with open(log_file, "w") as log:
+        process = subprocess.Popen([binary, "--config", config_file], stdout=log, stderr=subprocess.STDOUT)
+        _, status, usage = os.wait4(process.pid, 0)
+    wall = time.monotonic() - start
+    # ru_maxrss is in kB on Linux
+    return os.waitstatus_to_exitcode(status), wall, usage.ru_maxrss / 1024.0
+
+
+def main():
+    args = parse_args()
+
+    with open(args.config) as f:
+        base_config = yaml.safe_load(f)
+    sources = base_config.get("sources", [])
+
+    inputs = {}
+    for item in args.input:
+        name, _, files = item.partition("=")
+        inputs[name] = parse_list(files, str)
+    for source in sources:
+        if source.get("name") in inputs:
+            source["input_files"] = inputs[source["name"]]
+    sources = [source for source in sources if source.get("input_files")]
+    if not sources:
+        sys.exit("No sources with input files - use --input NAME=FILE")
+
+    durations = parse_list(args.durations, float) or [float(base_config.get("timeframe_duration", 2000.0))]
+    scales = parse_list(args.luminosity_scales, float)
+    n_sources = parse_list(args.n_sources, int) or [len(sources)]
+    threads = parse_list(args.threads, int)
+    compressions = parse_compression(args.compression)
+
+    os.makedirs(args.output_dir, exist_ok=True)
+
+    rows = []
+    matrix = list(itertools.product(durations, scales, n_sources, threads, compressions))
+    for run_index, (duration, scale, n, n_threads, (algorithm, level)) in enumerate(matrix):
+        tag = f"run{run_index:03d}"
+        config = copy.deepcopy(base_config)
+        config["sources"] = copy.deepcopy(sources[:n])
+        for source in config["sources"]:
+            if not source.get("static_number_of_events", False) and "mean_event_frequency" in source:
+                source["mean_event_frequency"] = float(source["mean_event_frequency"]) * scale
+        config["timeframe_duration"] = duration
+        config["max_events"] = args.timeframes
+        config["n_threads"] = n_threads
+        config["compression_algorithm"] = algorithm
+        config["compression_level"] = level
+        config.setdefault("random_seed", 1)
+        config["output_file"] = os.path.join(args.output_dir, tag + args.output_extension)
+        config["report_file"] = os.path.join(args.output_dir, tag + ".json")
+
+        config_file = os.path.join(args.output_dir, tag + ".yml")
+        with open(config_file, "w") as f:
+            yaml.safe_dump(config, f, sort_keys=False)
+
+        print(f"[{run_index + 1}/{len(matrix)}] duration={duration} scale={scale} sources={len(config['sources'])} "
+              f"threads={n_threads} compression={algorithm}:{level}", flush=True)
+        exit_code, wall, peak_rss_mb = run_builder(args.binary, config_file, os.path.join(args.output_dir, tag + ".log"))
+
+        row = {
+            "run": tag,
+            "timeframe_duration": duration,
+            "luminosity_scale": scale,
+            "n_sources": len(config["sources"]),
+            "n_threads": n_threads,
+            "compression": f"{algorithm}:{level}",
+            "exit_code": exit_code,
+            "wall_s": wall,
+            "peak_rss_mb": peak_rss_mb,
+        }
+        report = {}
+        if exit_code == 0 and os.path.exists(config["report_file"]):
+            with open(config["report_file"]) as f:
+                report = json.load(f)
+        for key in ["timeframes", "events", "total_time_s", "timeframes_per_s", "events_per_s",
+                    "output_bytes", "output_mb_per_s"]:
+            row[key] = report.get(key, "")
+        for stage in STAGES:
+            row[f"{stage}_s"] = report.get("stages_s", {}).get(stage, "")
+        rows.append(row)
+
+        if exit_code != 0 or not report:
+            print(f"  failed with exit code {exit_code}, see {os.path.join(args.output_dir, tag + '.log')}")
+        else:
+            print(f"  {row['timeframes_per_s']:.3f} timeframes/s, {row['events_per_s']:.1f} events/s, "
+                  f"{row['output_mb_per_s']:.2f} MB/s, peak RSS {peak_rss_mb:.0f} MB")
+
+        if not args.keep_outputs and os.path.exists(config["output_file"]):
+            os.remove(config["output_file"])
+
+    with open(args.csv, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=list(rows[0].keys()))
+        writer.writeheader()
+        writer.writerows(rows)
+    with open(args.json, "w") as f:
+        json.dump(rows, f, indent=2)
+    print(f"Results written to {args.csv} and {args.json}")
+
+    return 0 if all(row["exit_code"] == 0 for row in rows) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct CapacityPolicy
+ * @brief Parameters of the adaptive capacity management of merged collections
+ */
+struct CapacityPolicy {
+    size_t window = 50;           // Number of recent timeframe sizes kept per vector
+    float  quantile = 0.9f;       // Quantile of the recent sizes the capacity tracks
+    float  headroom = 1.2f;       // Multiplier applied to the quantile
+    size_t shrink_after = 10;     // Consecutive oversized timeframes before a vector is shrunk
+    size_t memory_cap_bytes = 0;  // Cap on the retained capacity of all managed vectors (0: no cap)
+};
+
+/**
+ * @class CapacityManager
+ * @brief Clears reused vectors while keeping their capacity near a rolling quantile of recent sizes
+ *
+ * clear() records the size a vector reached in the finished timeframe, and releases
+ * its excess capacity once it has been oversized for CapacityPolicy::shrink_after
+ * consecutive timeframes. enforceMemoryCap() then shrinks the most oversized vectors
+ * (and finally any vector) until the retained capacity is below the global cap.
+ *
+ * Shrinking swaps the contents with a freshly reserved vector, so the address of the
+ * vector object itself never changes and ROOT branch addresses stay valid.
+ */
+class CapacityManager {
+public:
+    explicit CapacityManager(const CapacityPolicy& policy) : policy_(policy) {}
+
+    /**
+     * Record the current size of a vector, shrink it if the policy says so, then clear it
+     */
+    template <typename T>
+    void clear(std::vector<T>& vec) {
+        auto [it, inserted] = states_.try_emplace(&vec);
+        VectorState& state = it->second;
+        if (inserted) {
+            state.element_size = sizeof(T);
+            state.shrink = [&vec](size_t capacity) {
+                std::vector<T> replacement;
+                replacement.reserve(capacity);
+                vec.swap(replacement);
+            };
+        }
+
+        size_t target = recordSize(state, vec.size());
+        vec.clear();
+        if (vec.capacity() > target) {
+            if (++state.oversized_frames >= policy_.shrink_after) {
+                shrink(state, vec.capacity(), target);
+            }
+        } else {
+            state.oversized_frames = 0;
+        }
+        state.capacity_bytes = vec.capacity() * sizeof(T);
+        state.target_bytes = target * sizeof(T);
+    }
+
+    /**
+     * Shrink vectors until the retained capacity of all managed vectors is below the cap
+     * Vectors furthest above their target are shrunk to the target first, then the
+     * largest vectors are released completely.
+     */
+    void enforceMemoryCap();
+
+    /**
+     * Total capacity in bytes currently retained by the managed vectors
+     */
+    size_t retainedBytes() const;
+
+    /**
+     * Print the number of shrinks and the memory released so far
+     */
+    void printStatistics() const;
+
+private:
+    struct VectorState {
+        std::vector<size_t> history;       // Ring buffer of recent sizes
+        size_t next = 0;                   // Next slot of the ring buffer
+        size_t oversized_frames = 0;       // Consecutive timeframes with capacity above target
+        size_t element_size = 0;
+        size_t capacity_bytes = 0;         // Capacity retained after the last clear
+        size_t target_bytes = 0;           // Target capacity from the rolling quantile
+        std::function<void(size_t)> shrink;  // Replace the storage with one of the given capacity
+    };
+
+    /**
+     * Append a size to the history and return the target capacity in elements
+     */
+    size_t recordSize(VectorState& state, size_t size);
+    void shrink(VectorState& state, size_t old_capacity, size_t new_capacity);
+
+    CapacityPolicy policy_;
+    std::unordered_map<const void*, VectorState> states_;
+    std::vector<size_t> scratch_;
+
+    size_t n_shrinks_ = 0;
+    size_t released_bytes_ = 0;
+};
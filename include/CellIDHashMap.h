@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @class CellIDHashMap
+ * @brief Open-addressing map from 64 bit cellIDs to 32 bit indices, reused every timeframe
+ *
+ * Linear probing in a power-of-two table kept at most half full. Slots are marked used
+ * with the generation of the current reset, so reset() forgets all keys in O(1) and the
+ * table is only reallocated when it has to grow. Every cellID value, 0 included, is a
+ * valid key.
+ */
+class CellIDHashMap {
+public:
+    // Prepare for up to n keys, forgetting the previous ones
+    void reset(size_t n) {
+        size_t capacity = 16;
+        while (capacity < 2 * n) {
+            capacity <<= 1;
+        }
+        if (capacity > keys_.size()) {
+            keys_.assign(capacity, 0);
+            values_.assign(capacity, 0);
+            stamps_.assign(capacity, 0);
+            generation_ = 0;
+        }
+        mask_ = keys_.size() - 1;
+        if (++generation_ == 0) {
+            stamps_.assign(stamps_.size(), 0);
+            generation_ = 1;
+        }
+    }
+
+    /**
+     * Value of key, inserting value when key is new
+     * @return The value stored for key and whether it was inserted
+     */
+    std::pair<uint32_t, bool> insert(uint64_t key, uint32_t value) {
+        size_t slot = hash(key) & mask_;
+        while (stamps_[slot] == generation_) {
+            if (keys_[slot] == key) {
+                return {values_[slot], false};
+            }
+            slot = (slot + 1) & mask_;
+        }
+        stamps_[slot] = generation_;
+        keys_[slot] = key;
+        values_[slot] = value;
+        return {value, true};
+    }
+
+    size_t capacity() const { return keys_.size(); }
+
+private:
+    // Final mix of MurmurHash3, spreading the bit fields of a cellID over the table
+    static uint64_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> values_;
+    std::vector<uint32_t> stamps_;
+    uint32_t generation_ = 0;
+    size_t mask_ = 0;
+};
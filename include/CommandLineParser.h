@@ -80,6 +80,19 @@ private:
      */
     static void validateConfiguration(MergerConfig& config);
 
+    /**
+     * Add a "<name>_bundles" already-merged source reading bundle_files right after
+     * every source with bundles
+     * @throws std::runtime_error if the bundle settings of a source are incomplete
+     */
+    static void expandBundledSources(MergerConfig& config);
+
+    /**
+     * Parse a --time-window value COLLECTION:T_MIN:T_MAX
+     * @throws std::runtime_error if the value is malformed
+     */
+    static CollectionTimeWindow parseTimeWindow(const std::string& value);
+
     /**
      * Print the parsed configuration to console
      * @param config MergerConfig to print
@@ -2,7 +2,9 @@
 
 #include "DataSource.h"
 #include "MergerConfig.h"
+#include "ThreadPool.h"
 #include <vector>
+#include <span>
 #include <string>
 #include <memory>
 
@@ -20,6 +22,13 @@ class DataHandler {
 public:
     virtual ~DataHandler() = default;
 
+    /**
+     * Set the global merger configuration (output compression etc.)
+     * Must be called before initializeDataSources
+     * @param config Merger configuration, must outlive the handler
+     */
+    void setConfig(const MergerConfig& config) { config_ = &config; }
+
     /**
      * Initialize data sources and output file
      * @param filename Output file path
@@ -42,12 +51,23 @@ public:
      * @param timeframe_duration Duration of the timeframe in ns
      * @param bunch_crossing_period Bunch crossing period in ns
      * @param gen Random number generator
+     * @return Total number of events merged into the timeframe
      */
-    virtual void mergeEvents(std::vector<std::unique_ptr<DataSource>>& sources,
-                            size_t timeframe_number,
-                            float timeframe_duration,
-                            float bunch_crossing_period,
-                            std::mt19937& gen) final;
+    virtual size_t mergeEvents(std::vector<std::unique_ptr<DataSource>>& sources,
+                              size_t timeframe_number,
+                              float timeframe_duration,
+                              float bunch_crossing_period,
+                              std::mt19937& gen) final;
+
+    /**
+     * Signal multiplexing (MergerConfig::signal_multiplex): once the background sources are
+     * merged, saveBackground keeps a copy of the timeframe, and restoreBackground replaces
+     * the current timeframe with that copy instead of prepareTimeframe, so new signal events
+     * can be overlaid without reading and processing the background again
+     */
+    virtual bool supportsSignalMultiplex() const { return false; }
+    virtual void saveBackground() {}
+    virtual void restoreBackground() {}
 
     /**
      * Write the completed timeframe to output
@@ -59,6 +79,12 @@ public:
      */
     virtual void finalize() = 0;
 
+    /**
+     * Append the size and capacity of the merged buffers and output tree held by the handler
+     * @param usage Usage list to append to
+     */
+    virtual void collectMemoryUsage(MemoryUsage& usage) const {}
+
     /**
      * Get the format name
      */
@@ -66,14 +92,64 @@ public:
 
 protected:
     /**
-     * Process a single loaded event during merging
-     * Implemented by concrete handlers for format-specific logic
-     * Called after loadEvent and UpdateTimeOffset have been applied
+     * Merge the entries needed from one source into the current timeframe
+     * Implemented by FormatDataHandler, which runs the per-event loop without virtual calls
+     * @return Number of events merged
      */
-    virtual void processEvent(DataSource& source) = 0;
+    virtual size_t mergeSource(DataSource& source,
+                               float timeframe_duration,
+                               float bunch_crossing_period,
+                               std::mt19937& gen) = 0;
+
+    /**
+     * Whether the handler implements the parallel gather below (MergerConfig::parallel_sources)
+     */
+    virtual bool supportsParallelGather() const { return false; }
+
+    // Consecutive entries of one source gathered by one task
+    struct GatherChunk {
+        size_t source = 0;       // Index of the source
+        size_t first_entry = 0;  // First entry read
+        size_t first_draw = 0;   // Position of the chunk in the source's entries of the timeframe
+        size_t entries = 0;
+    };
+
+    /**
+     * Parallel gather: prepareStaging once per timeframe, then gatherChunk for every chunk
+     * concurrently, each into its own staging slot, then concatenateStaging to append the
+     * slots to the timeframe in chunk order (source order, then entry order)
+     * @param draws Time offset draws of the chunk's entries
+     */
+    virtual void prepareStaging(const std::vector<std::unique_ptr<DataSource>>& sources,
+                                const std::vector<GatherChunk>& chunks) {}
+    virtual void gatherChunk(size_t slot,
+                             const GatherChunk& chunk,
+                             DataSource& source,
+                             std::span<const DataSource::TimeOffsetDraw> draws);
+    virtual void concatenateStaging() {}
     
+    /**
+     * ROOT compression settings (algorithm * 100 + level) from the merger configuration
+     * @throws std::runtime_error if the configured algorithm is unknown
+     */
+    int getCompressionSettings() const;
+
+    const MergerConfig* config_ = nullptr;
     size_t current_timeframe_number_ = 0;
 
+private:
+    size_t gatherEvents(std::vector<std::unique_ptr<DataSource>>& sources,
+                        float timeframe_duration,
+                        float bunch_crossing_period,
+                        std::mt19937& gen);
+
+    // Workers of the parallel gather, created on first use
+    std::unique_ptr<ThreadPool> thread_pool_;
+
+    // Chunks and time offset draws (per source) of the current timeframe
+    std::vector<GatherChunk> chunks_;
+    std::vector<std::vector<DataSource::TimeOffsetDraw>> time_offset_draws_;
+
 public:
     /**
      * Factory method to create appropriate data handler based on filename
@@ -82,4 +158,15 @@ public:
      * @throws std::runtime_error if format is not supported
      */
     static std::unique_ptr<DataHandler> create(const std::string& filename);
+
+    /**
+     * Factory method taking the input format into account
+     * HepMC3 sources with EDM4hep output are converted to MCParticles while merging
+     * @param filename Output file path
+     * @param source_configs Source configurations (input files)
+     * @return Unique pointer to appropriate DataHandler implementation
+     * @throws std::runtime_error if the format is not supported or input formats are mixed
+     */
+    static std::unique_ptr<DataHandler> create(const std::string& filename,
+                                               const std::vector<SourceConfig>& source_configs);
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MergerConfig.h"
+#include "MemoryAccounting.h"
 #include <memory>
 #include <vector>
 #include <string>
@@ -39,8 +40,25 @@ public:
     
     // Event loading and time offset update
     virtual void loadEvent(size_t event_index) = 0;
-    void UpdateTimeOffset(float timeframe_duration, float bunch_crossing_period, 
-                         std::mt19937& rng);
+
+    // Random part of a time offset. It does not depend on the event, so the offsets of a
+    // timeframe can be drawn before its entries are read (see DataHandler::gatherEvents)
+    struct TimeOffsetDraw {
+        float base = 0.0f;    // Uniform in the timeframe, on a bunch crossing if enabled
+        float spread = 0.0f;  // Gaussian beam spread
+    };
+    TimeOffsetDraw drawTimeOffset(float timeframe_duration, float bunch_crossing_period, std::mt19937& rng) const;
+    // Time offset from a draw and the beam distance of the loaded event
+    void UpdateTimeOffset(const TimeOffsetDraw& draw, float distance);
+
+    // Distance of a vertex along a beam rotated around y, given cos/sin of the beam angle
+    static float beamDistance(float x, float z, float cos_angle, float sin_angle) {
+        return z * cos_angle + x * sin_angle;
+    }
+
+    // Expected number of entries read per timeframe, matching the sampling in
+    // TimeframeBuilder::updateInputNEvents (Poisson mean for frequency based sources)
+    double expectedEntriesPerTimeframe(float timeframe_duration) const;
     
     // Configuration access
     const SourceConfig& getConfig() const { return *config_; }
@@ -50,6 +68,9 @@ public:
     // Status and diagnostics
     virtual void printStatus() const = 0;
     virtual bool isInitialized() const = 0;
+
+    // Append the size and capacity of the buffers owned by this source
+    virtual void collectMemoryUsage(MemoryUsage& usage) const {}
     
     // Format-specific getters (to be implemented by concrete classes)
     virtual std::string getFormatName() const = 0;
@@ -63,6 +84,14 @@ protected:
     size_t total_entries_ = 0;
     size_t current_entry_index_ = 0;
     size_t entries_needed_ = 0;
+
+    // First input entry of the range read by this source; entry indices and
+    // total_entries_ are relative to it (see restrictToEntryPart)
+    size_t entry_offset_ = 0;
+    
+    // Narrow total_entries_ to the entry_part of entry_parts of the config, called
+    // once the input is open
+    void restrictToEntryPart();
     
     // Time offset state (shared across implementations)
     float current_time_offset_ = 0.0f;
@@ -77,10 +106,6 @@ protected:
     // Format-specific vertex extraction (must be implemented by derived classes)
     virtual VertexPosition getBeamVertexPosition() const = 0;
     
-    // Shared beam distance calculation using vertex and beam angle
-    float calculateBeamDistance() const;
-    
-    // Shared time offset generation logic
-    float generateTimeOffset(float distance, float timeframe_duration, 
-                            float bunch_crossing_period, std::mt19937& rng) const;
+    // Shared time offset logic
+    float applyTimeOffset(const TimeOffsetDraw& draw, float distance) const;
 };
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "MemoryAccounting.h"
+#include <edm4hep/MCParticleData.h>
+#include <edm4hep/SimTrackerHitData.h>
+#include <edm4hep/SimCalorimeterHitData.h>
+#include <edm4hep/CaloHitContributionData.h>
+#include <edm4hep/EventHeaderData.h>
+#include <podio/ObjectID.h>
+#include <TChain.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @struct EDM4hepBranchBuffers
+ * @brief Decode buffers for one set of EDM4hep input branches
+ *
+ * The vectors are heap allocated because ROOT binds branches to the address of
+ * the pointer slots held here. A set of buffers can be shared by several sources
+ * with the same schema; the input reader that last bound its chain is the owner and
+ * the buffers hold the most recently read entry.
+ */
+struct EDM4hepBranchBuffers {
+    EDM4hepBranchBuffers(const std::vector<std::string>& tracker_collections,
+                         const std::vector<std::string>& calo_collections,
+                         const std::vector<std::string>& gp_collections,
+                         bool read_sub_event_headers);
+    ~EDM4hepBranchBuffers();
+
+    EDM4hepBranchBuffers(const EDM4hepBranchBuffers&) = delete;
+    EDM4hepBranchBuffers& operator=(const EDM4hepBranchBuffers&) = delete;
+
+    /**
+     * Names of all branches these buffers can be bound to
+     */
+    static std::vector<std::string> branchNames(const std::vector<std::string>& tracker_collections,
+                                                const std::vector<std::string>& calo_collections,
+                                                const std::vector<std::string>& gp_collections,
+                                                bool read_sub_event_headers);
+
+    /**
+     * Bind the available branches of a chain to these buffers
+     * @param chain Input chain
+     * @param available_branches Branches present in the chain (others keep empty buffers)
+     */
+    void bind(TChain& chain, const std::unordered_set<std::string>& available_branches);
+
+    /**
+     * Copy the contents of buffers with the same layout, reusing the existing capacity
+     */
+    void copyFrom(const EDM4hepBranchBuffers& other);
+
+    // Append size and capacity of every buffer under the given owner name
+    void collectMemoryUsage(MemoryUsage& usage, const std::string& owner_name) const;
+
+    // Branch pointers for reading data as vectors
+    std::vector<edm4hep::MCParticleData>* mcparticles = nullptr;
+    std::unordered_map<std::string, std::vector<edm4hep::SimTrackerHitData>*> tracker_hits;
+    std::unordered_map<std::string, std::vector<edm4hep::SimCalorimeterHitData>*> calo_hits;
+    std::unordered_map<std::string, std::vector<edm4hep::CaloHitContributionData>*> calo_contributions;
+    std::unordered_map<std::string, std::vector<edm4hep::EventHeaderData>*> event_headers;
+
+    // Branch pointers for reading ObjectID references
+    std::unordered_map<std::string, std::vector<podio::ObjectID>*> objectids;
+
+    // Branch pointers for reading GP (Global Parameter) branches
+    std::unordered_map<std::string, std::vector<std::string>*> gp_keys;
+    std::vector<std::vector<int>>* gp_int_values = nullptr;
+    std::vector<std::vector<float>>* gp_float_values = nullptr;
+    std::vector<std::vector<double>>* gp_double_values = nullptr;
+    std::vector<std::vector<std::string>>* gp_string_values = nullptr;
+
+    // Owner name used for memory accounting
+    std::string name;
+
+    // Input reader whose chain is currently bound to these buffers
+    const void* owner = nullptr;
+
+    // Source responsible for reporting these buffers' memory (the first user)
+    const void* reporter = nullptr;
+};
+
+/**
+ * @class EDM4hepBufferPool
+ * @brief Shares decode buffers between sources with identical schemas
+ *
+ * Sources are merged one after another, so sources reading the same set of
+ * branches can decode into the same buffers as long as each rebinds its chain
+ * before reading (see EDM4hepDataSource::loadEvent).
+ */
+class EDM4hepBufferPool {
+public:
+    /**
+     * Get the buffers for a schema signature, creating them on first use
+     * @param signature Identifies the set of bound branches
+     * @param create Factory for new buffers
+     */
+    template <typename Factory>
+    std::shared_ptr<EDM4hepBranchBuffers> acquire(const std::string& signature, Factory&& create) {
+        auto& buffers = pool_[signature];
+        if (!buffers) {
+            buffers = create();
+        }
+        return buffers;
+    }
+
+    size_t size() const { return pool_.size(); }
+
+private:
+    std::unordered_map<std::string, std::shared_ptr<EDM4hepBranchBuffers>> pool_;
+};
@@ -1,7 +1,11 @@
 #pragma once
 
-#include "DataHandler.h"
+#include "FormatDataHandler.h"
 #include "EDM4hepDataSource.h"
+#include "CapacityPolicy.h"
+#include "IOBudgetManager.h"
+#include "RadixSort.h"
+#include "CellIDHashMap.h"
 #include <edm4hep/MCParticleData.h>
 #include <edm4hep/SimTrackerHitData.h>
 #include <edm4hep/SimCalorimeterHitData.h>
@@ -14,6 +18,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
 
 // Struct to organize all merged EDM4hep collections
 struct EDM4hepMergedCollections {
@@ -42,8 +47,36 @@ struct EDM4hepMergedCollections {
     std::vector<std::vector<float>> gp_float_values;
     std::vector<std::vector<double>> gp_double_values;
     std::vector<std::vector<std::string>> gp_string_values;
+
+    // Lazy time offsets: offset still to apply per sub-event and, per time carrying
+    // collection, the first element of each sub-event (see SubEventTimeOffsets)
+    std::vector<float> sub_event_time_offsets;
+    std::unordered_map<std::string, std::vector<uint32_t>> sub_event_begins;
     
     void clear();
+
+    // Copy the contents of other, keeping the vector objects (bound to output branches) in place
+    void copyFrom(const EDM4hepMergedCollections& other);
+
+    // Clear while letting the capacity manager shrink oversized vectors
+    void clear(CapacityManager& capacity_manager);
+
+    // Append size and capacity of every merged vector
+    void collectMemoryUsage(MemoryUsage& usage, const std::string& owner = "merged") const;
+
+    // Create the output branches of the merged collections (podio layout)
+    void setupBranches(TTree* tree,
+                       const std::vector<std::string>& tracker_collection_names,
+                       const std::vector<std::string>& calo_collection_names,
+                       const std::vector<std::string>& gp_collection_names);
+
+    // Create the sub-event offset and range branches of lazy time offsets
+    void setupSubEventOffsetBranches(TTree* tree, const std::vector<std::string>& time_collection_names);
+
+private:
+    // Apply clear_vector to every merged vector
+    template <typename ClearFn>
+    void clearVectors(ClearFn&& clear_vector);
 };
 
 /**
@@ -53,7 +86,7 @@ struct EDM4hepMergedCollections {
  * Handles both input (creating EDM4hepDataSource instances) and output
  * (writing merged timeframe data) in EDM4hep format using ROOT TTree.
  */
-class EDM4hepDataHandler : public DataHandler {
+class EDM4hepDataHandler : public FormatDataHandler<EDM4hepDataHandler, EDM4hepDataSource> {
 public:
     EDM4hepDataHandler() = default;
     ~EDM4hepDataHandler() override = default;
@@ -63,10 +96,16 @@ public:
         const std::vector<SourceConfig>& source_configs) override;
     
     void prepareTimeframe() override;
+
+    bool supportsSignalMultiplex() const override { return true; }
+    void saveBackground() override;
+    void restoreBackground() override;
     
     void writeTimeframe() override;
     
     void finalize() override;
+
+    void collectMemoryUsage(MemoryUsage& usage) const override;
     
     std::string getFormatName() const override { return "EDM4hep"; }
 
@@ -74,9 +113,87 @@ private:
     std::unique_ptr<TFile> output_file_;
     TTree* output_tree_ = nullptr;
     EDM4hepMergedCollections collections_;
+
+    // Decode buffers shared by sources with the same schema (null when disabled)
+    std::unique_ptr<EDM4hepBufferPool> buffer_pool_;
+
+    // Input readers shared by sources reading the same files, keyed by EDM4hepInputReader::key
+    std::unordered_map<std::string, std::shared_ptr<EDM4hepInputReader>> input_readers_;
+
+    // Global TTreeCache budget across the input chains (null when disabled)
+    std::unique_ptr<IOBudgetManager> io_budget_;
+
+    // Adaptive capacity of the merged collections (null when disabled)
+    std::unique_ptr<CapacityManager> capacity_manager_;
     
     // Store validated EDM4hep data sources (non-owning pointers)
     std::vector<EDM4hepDataSource*> edm4hep_sources_;
+
+    // Sub-events merged so far (SubEventHeader event numbers)
+    int events_consumed_ = 0;
+    // Sub-events appended to collections_ in the current timeframe
+    size_t timeframe_events_ = 0;
+
+    // Leave times unshifted and record the offsets per sub-event (MergerConfig::lazy_time_offsets)
+    bool lazy_time_offsets_ = false;
+    // Collections with times, in recordSubEvent order
+    std::vector<std::string> time_collection_names_;
+
+    // Acceptance windows by tracker and calorimeter collection (MergerConfig::time_windows)
+    struct TimeWindow {
+        float t_min;
+        float t_max;
+    };
+    std::unordered_map<std::string, TimeWindow> time_windows_;
+    std::vector<uint32_t> window_index_;  // Scratch: elements kept before each index
+    size_t dropped_tracker_hits_ = 0;
+    size_t dropped_contributions_ = 0;
+    size_t dropped_calo_hits_ = 0;
+
+    // Calorimeter pile-up by cellID (MergerConfig::calo_pileup), buffers reused every timeframe
+    CellIDHashMap cell_hits_;
+    std::vector<uint32_t> pileup_hit_of_;  // Combined hit of each hit
+    std::vector<uint32_t> pileup_cursor_;  // Next reference slot of each combined hit
+    std::vector<edm4hep::SimCalorimeterHitData> pileup_hits_;
+    std::vector<podio::ObjectID> pileup_refs_;
+    std::vector<float> pileup_contribution_times_;  // Shifted time of each contribution
+    std::vector<std::pair<float, podio::ObjectID>> pileup_timed_refs_;
+    size_t pileup_combined_hits_ = 0;
+
+    // Sorting by time (MergerConfig::sort_by_time): one task per tracker, then calorimeter collection
+    struct SortScratch {
+        radix_sort::Scratch radix;
+        std::vector<uint32_t> visited;
+        std::vector<uint32_t> inverse;
+        std::vector<float> hit_times;
+        std::vector<podio::ObjectID> refs;
+        // Copies gathered from when a large collection is sorted over the whole pool
+        std::vector<edm4hep::SimTrackerHitData> tracker_hits;
+        std::vector<edm4hep::SimCalorimeterHitData> calo_hits;
+        std::vector<edm4hep::CaloHitContributionData> contributions;
+    };
+    std::unique_ptr<ThreadPool> sort_pool_;
+    std::vector<SortScratch> sort_scratch_;
+    std::vector<size_t> sort_tasks_;        // Sorted concurrently, one thread each
+    std::vector<size_t> split_sort_tasks_;  // Sorted one after the other, passes split over the pool
+
+    // Background timeframe overlaid with new signal events by signal multiplexing
+    EDM4hepMergedCollections background_;
+    size_t background_events_ = 0;
+
+    // Per-chunk staging of the parallel gather, concatenated in chunk order
+    struct StagingSlot {
+        EDM4hepMergedCollections collections;
+        int events = 0;
+        std::string name;
+        bool already_merged = false;
+    };
+    std::vector<StagingSlot> staging_;
+
+    // Idle readers for chunks beyond the first of a source, by source index
+    std::mutex chunk_readers_mutex_;
+    std::unordered_map<size_t, std::vector<std::unique_ptr<EDM4hepDataSource>>> chunk_readers_;
+    std::unique_ptr<EDM4hepDataSource> acquireChunkReader(const EDM4hepDataSource& source);
     
     // Collection names discovered from sources
     std::vector<std::string> tracker_collection_names_;
@@ -89,10 +206,55 @@ private:
     std::vector<std::string> discoverCollectionNames(DataSource& source, const std::string& branch_pattern);
     std::vector<std::string> discoverGPBranches(DataSource& source);
     void copyPodioMetadata(const std::vector<std::unique_ptr<DataSource>>& sources);
-    void copyAndUpdatePodioMetadataTree(TTree* source_metadata_tree, TFile* output_file);
+    void setupIOBudget();
+    void setupTimeWindows();
+    // Drop the hits and contributions of collections_ outside their window, remapping references
+    void applyTimeWindows();
+    // Combine the calorimeter hits of collections_ sharing a cellID, contributions in time order
+    void combineCaloPileup();
+    void setupTimeSort();
+    // Sort the hit collections of collections_ by time, permuting and remapping their references
+    void sortByTime();
+    // Sort one collection by a single thread, or with its passes split over pool if given
+    void sortTrackerHits(const std::string& name, SortScratch& scratch, ThreadPool* pool);
+    // Contributions by time, then hits by their earliest contribution with contiguous references
+    void sortCaloHits(const std::string& name, SortScratch& scratch, ThreadPool* pool);
     std::string getCorrespondingContributionCollection(const std::string& calo_collection_name) const;
     std::string getCorrespondingCaloCollection(const std::string& contrib_collection_name) const;
-    
+
+protected:
+    friend class FormatDataHandler<EDM4hepDataHandler, EDM4hepDataSource>;
+
     // Format-specific event processing
-    void processEvent(DataSource& source) override;
+    void processEvent(EDM4hepDataSource& source);
+
+    /**
+     * Append the loaded event of a source to a set of merged collections
+     * @param events_consumed Sub-events already in the collections (SubEventHeader event number)
+     * @param first_contributor Nothing was appended to the collections since they were cleared
+     */
+    void appendEvent(EDM4hepDataSource& source, EDM4hepMergedCollections& collections, int events_consumed,
+                     bool first_contributor);
+
+    /**
+     * Record a sub-event for lazy time offsets, starting at the current end of every
+     * collection with times
+     */
+    void recordSubEvent(EDM4hepMergedCollections& collections, float time_offset);
+
+    /**
+     * Hand the decoded buffers of a pre-merged timeframe to empty merged collections
+     * by swapping them, instead of appending them element by element
+     */
+    void swapInMergedTimeframe(EDM4hepDataSource& source, EDM4hepMergedCollections& collections);
+
+    // Parallel gather into per-chunk staging collections
+    bool supportsParallelGather() const override { return true; }
+    void prepareStaging(const std::vector<std::unique_ptr<DataSource>>& sources,
+                        const std::vector<GatherChunk>& chunks) override;
+    void gatherChunk(size_t slot,
+                     const GatherChunk& chunk,
+                     DataSource& source,
+                     std::span<const DataSource::TimeOffsetDraw> draws) override;
+    void concatenateStaging() override;
 };
@@ -2,6 +2,8 @@
 
 #include "DataSource.h"
 #include "MergerConfig.h"
+#include "EDM4hepBranchBuffers.h"
+#include "EDM4hepInputReader.h"
 #include <edm4hep/MCParticleData.h>
 #include <edm4hep/SimTrackerHitData.h>
 #include <edm4hep/SimCalorimeterHitData.h>
@@ -11,6 +13,7 @@
 #include <TChain.h>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <string>
 #include <random>
@@ -22,10 +25,29 @@
  * Handles all EDM4hep-specific logic for reading events from ROOT files
  * with TChain, managing branches, applying time offsets, and merging data.
  */
-class EDM4hepDataSource : public DataSource {
+class EDM4hepDataSource final : public DataSource {
 public:
     EDM4hepDataSource(const SourceConfig& config, size_t source_index);
-    ~EDM4hepDataSource();
+    ~EDM4hepDataSource() = default;
+
+    /**
+     * Share decode buffers with other sources of the same schema
+     * Must be called before initialize
+     */
+    void setBufferPool(EDM4hepBufferPool* pool) { buffer_pool_ = pool; }
+
+    /**
+     * Read through an input reader shared with other sources using the same files
+     * Must be called before initialize; otherwise the source opens its own reader
+     */
+    void setInputReader(std::shared_ptr<EDM4hepInputReader> reader) { reader_ = std::move(reader); }
+    EDM4hepInputReader* getInputReader() const { return reader_.get(); }
+
+    /**
+     * Leave particle and hit times unshifted; the merger records the offsets per
+     * sub-event instead (MergerConfig::lazy_time_offsets)
+     */
+    void setLazyTimeOffsets(bool lazy) { lazy_time_offsets_ = lazy; }
     
     // Initialization
     void initialize(const std::vector<std::string>& tracker_collections,
@@ -39,6 +61,9 @@ public:
     // Event loading
     void loadEvent(size_t event_index) override;
 
+    // Vertex of the first generator particle (public for the statically dispatched merge loop)
+    VertexPosition getBeamVertexPosition() const override;
+
     // Data processing methods for EDM4hep format
     std::vector<edm4hep::MCParticleData>& processMCParticles(size_t particle_parents_offset,
                                                              size_t particle_daughters_offset,
@@ -69,49 +94,30 @@ public:
     
     // Status and diagnostics
     void printStatus() const override;
-    bool isInitialized() const override { return chain_ != nullptr; }
+    bool isInitialized() const override { return reader_ != nullptr; }
+    void collectMemoryUsage(MemoryUsage& usage) const override;
     std::string getFormatName() const override { return "EDM4hep"; }
 
 private:
-    // ROOT chain and state
-    std::unique_ptr<TChain> chain_;
+    // Decode buffers, private or shared with sources of the same schema
+    // (declared before the reader, whose chain is bound to them)
+    std::shared_ptr<EDM4hepBranchBuffers> buffers_;
+    EDM4hepBufferPool* buffer_pool_ = nullptr;
+
+    // Input chain, private or shared with sources reading the same files
+    std::shared_ptr<EDM4hepInputReader> reader_;
     
     // Collection names (references to shared data)
     const std::vector<std::string>* tracker_collection_names_;
     const std::vector<std::string>* calo_collection_names_;
     const std::vector<std::string>* gp_collection_names_;
-    
-    // Branch pointers for reading data as vectors
-    std::vector<edm4hep::MCParticleData>* mcparticle_branch_;
-    std::unordered_map<std::string, std::vector<edm4hep::SimTrackerHitData>*> tracker_hit_branches_;
-    std::unordered_map<std::string, std::vector<edm4hep::SimCalorimeterHitData>*> calo_hit_branches_;
-    std::unordered_map<std::string, std::vector<edm4hep::CaloHitContributionData>*> calo_contrib_branches_;
-    std::unordered_map<std::string, std::vector<edm4hep::EventHeaderData>*> event_header_branches_;
-    
-    // Branch pointers for reading ObjectID references
-    std::unordered_map<std::string, std::vector<podio::ObjectID>*> objectid_branches_;
-    
-    // Branch pointers for reading GP (Global Parameter) branches
-    std::unordered_map<std::string, std::vector<std::string>*> gp_key_branches_;
-    std::vector<std::vector<int>>* gp_int_branch_;
-    std::vector<std::vector<float>>* gp_float_branch_;
-    std::vector<std::vector<double>>* gp_double_branch_;
-    std::vector<std::vector<std::string>>* gp_string_branch_;
 
     // Current event processing state
     size_t current_particle_index_offset_;
+    bool lazy_time_offsets_ = false;
     
     // Private helper methods
     void setupBranches();
-    void setupMCParticleBranches();
-    void setupTrackerBranches();
-    void setupCalorimeterBranches();
-    void setupEventHeaderBranches();
-    void setupGPBranches();
-    void cleanup();
-    
-    // Format-specific vertex extraction from EDM4hep MCParticles (overrides base class)
-    VertexPosition getBeamVertexPosition() const override;
     
     // Helper methods for collection name mapping
     std::string getCorrespondingContributionCollection(const std::string& calo_collection_name) const;
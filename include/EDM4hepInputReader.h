@@ -0,0 +1,110 @@
+#pragma once
+
+#include "EDM4hepBranchBuffers.h"
+#include "MemoryAccounting.h"
+#include <TChain.h>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @class EDM4hepInputReader
+ * @brief TChain over one set of EDM4hep input files, shared by all sources reading them
+ *
+ * Sources backed by the same files (and tree) share one reader, and so one TChain,
+ * one TTreeCache and one set of decompressed baskets, while keeping their own entry
+ * cursors, rates and offsets. Recently decoded entries are kept as pristine copies in
+ * a small LRU cache, so a source reading an entry another source has just read gets a
+ * copy instead of decoding it again.
+ */
+class EDM4hepInputReader {
+public:
+    /**
+     * Open the chain
+     * @param tree_name Name of the event tree
+     * @param files Input files
+     * @throws std::runtime_error if a file cannot be added or the chain is empty
+     */
+    EDM4hepInputReader(const std::string& tree_name, const std::vector<std::string>& files);
+
+    /**
+     * Number of decoded entries kept in the LRU cache (0 disables it)
+     * Only useful when several sources share the reader
+     */
+    void setCacheEntries(size_t cache_entries) { cache_entries_ = cache_entries; }
+
+    /**
+     * Key identifying readers that can be shared: tree name, merged flag and file list
+     */
+    static std::string key(const std::string& tree_name, const std::vector<std::string>& files, bool already_merged);
+
+    /**
+     * Determine which of the branches the sources want are present in the input
+     * The first call fixes the schema; later calls by sharing sources are no-ops
+     */
+    void configure(const std::vector<std::string>& tracker_collections,
+                   const std::vector<std::string>& calo_collections,
+                   const std::vector<std::string>& gp_collections,
+                   bool read_sub_event_headers);
+
+    /**
+     * Read an entry into the given buffers, from the decode cache if possible
+     * The chain is rebound to the buffers when another reader or buffer set was used last
+     */
+    void read(size_t entry, EDM4hepBranchBuffers& buffers);
+
+    size_t getEntries() const { return entries_; }
+    const std::unordered_set<std::string>& getAvailableBranches() const { return available_branches_; }
+    const std::string& getSchemaSignature() const { return signature_; }
+    TChain* getChain() const { return chain_.get(); }
+
+    /**
+     * Number of sources using this reader
+     */
+    void addUser() { ++users_; }
+    size_t getUsers() const { return users_; }
+
+    // Append basket, TTreeCache and decode cache memory under the given owner name
+    void collectMemoryUsage(MemoryUsage& usage, const std::string& owner_name) const;
+
+    void printStatistics(const std::string& name) const;
+
+    // Source responsible for reporting this reader's memory (the first user)
+    const void* reporter = nullptr;
+
+private:
+    struct CachedEntry {
+        size_t entry;
+        std::unique_ptr<EDM4hepBranchBuffers> buffers;
+    };
+
+    std::unique_ptr<TChain> chain_;
+    size_t entries_ = 0;
+
+    // Schema
+    bool configured_ = false;
+    const std::vector<std::string>* tracker_collection_names_ = nullptr;
+    const std::vector<std::string>* calo_collection_names_ = nullptr;
+    const std::vector<std::string>* gp_collection_names_ = nullptr;
+    bool read_sub_event_headers_ = true;
+    std::unordered_set<std::string> available_branches_;
+    std::string signature_;
+
+    // Buffers the chain is currently bound to
+    EDM4hepBranchBuffers* bound_buffers_ = nullptr;
+
+    // LRU cache of pristine decoded entries (most recent first)
+    size_t cache_entries_ = 0;
+    std::list<CachedEntry> cache_;
+    std::unordered_map<size_t, std::list<CachedEntry>::iterator> cache_index_;
+
+    size_t users_ = 0;
+    size_t cache_hits_ = 0;
+    size_t cache_misses_ = 0;
+
+    void storeInCache(size_t entry, const EDM4hepBranchBuffers& buffers);
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "DataHandler.h"
+#include <cmath>
+#include <span>
+
+/**
+ * @class FormatDataHandler
+ * @brief Statically dispatched per-event merge loop shared by the format handlers
+ *
+ * Derived must provide processEvent(SourceT&) and create only SourceT sources in
+ * initializeDataSources. The source is cast once per source and timeframe; with
+ * SourceT final, loadEvent, getBeamVertexPosition and processEvent are direct calls
+ * the compiler can inline, so the only virtual call left per source is mergeSource.
+ * Derived handlers befriend this class to keep processEvent protected.
+ */
+template <typename Derived, typename SourceT>
+class FormatDataHandler : public DataHandler {
+protected:
+    size_t mergeSource(DataSource& source,
+                       float timeframe_duration,
+                       float bunch_crossing_period,
+                       std::mt19937& gen) final {
+        auto& handler = static_cast<Derived&>(*this);
+        return runEventLoop(source, timeframe_duration, bunch_crossing_period, gen,
+                            [&handler](SourceT& typed_source) { handler.processEvent(typed_source); });
+    }
+
+    /**
+     * Load, time shift and hand every entry needed from the source to process(SourceT&)
+     * @return Number of events processed
+     */
+    template <typename Process>
+    size_t runEventLoop(DataSource& source,
+                        float timeframe_duration,
+                        float bunch_crossing_period,
+                        std::mt19937& gen,
+                        Process&& process) {
+        auto& typed_source = static_cast<SourceT&>(source);
+        const size_t entries_needed = typed_source.getEntriesNeeded();
+        forEachEntry(typed_source, typed_source.getCurrentEntryIndex(), entries_needed,
+                     [&](size_t) { return typed_source.drawTimeOffset(timeframe_duration, bunch_crossing_period, gen); },
+                     process);
+        return entries_needed;
+    }
+
+    /**
+     * Same for a chunk of entries read through reader, with time offsets drawn beforehand
+     * @param draws One draw per entry of the chunk
+     */
+    template <typename Process>
+    void runChunk(SourceT& reader,
+                  size_t first_entry,
+                  std::span<const DataSource::TimeOffsetDraw> draws,
+                  Process&& process) {
+        forEachEntry(reader, first_entry, draws.size(), [&](size_t i) { return draws[i]; }, process);
+    }
+
+private:
+    template <typename Draw, typename Process>
+    void forEachEntry(SourceT& reader, size_t first_entry, size_t entries, Draw&& draw, Process& process) {
+        // Per-source constants of the beam distance, hoisted out of the event loop
+        const auto& config = reader.getConfig();
+        const bool needs_distance = !config.already_merged && config.attach_to_beam;
+        const float cos_angle = std::cos(config.beam_angle);
+        const float sin_angle = std::sin(config.beam_angle);
+
+        for (size_t i = 0; i < entries; ++i) {
+            // Load and prepare the event
+            reader.setCurrentEntryIndex(first_entry + i);
+            reader.loadEvent(first_entry + i);
+            float distance = 0.0f;
+            if (needs_distance) {
+                auto vertex = reader.getBeamVertexPosition();
+                distance = DataSource::beamDistance(vertex.x, vertex.z, cos_angle, sin_angle);
+            }
+            reader.UpdateTimeOffset(draw(i), distance);
+
+            // Format-specific processing
+            process(reader);
+        }
+        reader.setCurrentEntryIndex(first_entry + entries);
+    }
+};
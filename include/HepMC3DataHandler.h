@@ -1,11 +1,13 @@
 #pragma once
 
-#include "DataHandler.h"
+#include "FormatDataHandler.h"
 #include "HepMC3DataSource.h"
-#include <HepMC3/WriterRootTree.h>
-#include <HepMC3/GenEvent.h>
-#include <HepMC3/GenVertex.h>
-#include <HepMC3/GenParticle.h>
+#include "HepMC3EventFilter.h"
+#include "HepMC3EventIndex.h"
+#include <HepMC3/Data/GenEventData.h>
+#include <HepMC3/Data/GenRunInfoData.h>
+#include <TFile.h>
+#include <TTree.h>
 #include <memory>
 #include <vector>
 #include <string>
@@ -17,8 +19,15 @@
  * Handles both input (creating HepMC3DataSource instances) and output
  * (writing merged timeframe data) in HepMC3 format using ROOT tree format.
  * Merges multiple HepMC3 events into single timeframe events with time offsets applied.
+ *
+ * Merging works on the flat HepMC3::GenEventData representation: the particle and
+ * vertex arrays of each sub-event are appended to one reused GenEventData with
+ * index and time offsets applied to the links and vertex positions, and the result
+ * is written to the same hepmc3_tree/hepmc3_event layout as HepMC3::WriterRootTree.
+ * No event graph is built, so a timeframe costs no allocations once the arrays
+ * have grown to their working size.
  */
-class HepMC3DataHandler : public DataHandler {
+class HepMC3DataHandler : public FormatDataHandler<HepMC3DataHandler, HepMC3DataSource> {
 public:
     HepMC3DataHandler() = default;
     ~HepMC3DataHandler() override = default;
@@ -32,26 +41,65 @@ public:
     void writeTimeframe() override;
     
     void finalize() override;
+
+    void collectMemoryUsage(MemoryUsage& usage) const override;
     
     std::string getFormatName() const override { return "HepMC3"; }
 
+    /**
+     * Create a HepMC3DataSource per configuration and start the read-ahead of prefetching sources
+     * Shared by the handlers reading HepMC3 input
+     * @param hepmc3_sources Filled with non-owning pointers to the created sources
+     * @throws std::runtime_error if a source has no .hepmc3.tree.root input
+     */
+    static std::vector<std::unique_ptr<DataSource>> createSources(const std::vector<SourceConfig>& source_configs,
+                                                                  float timeframe_duration,
+                                                                  std::vector<HepMC3DataSource*>& hepmc3_sources);
+
 private:
-    std::shared_ptr<HepMC3::WriterRootTree> writer_;
-    std::unique_ptr<HepMC3::GenEvent> current_timeframe_;
+    // Output file and tree in the HepMC3::WriterRootTree layout
+    std::unique_ptr<TFile> output_file_;
+    TTree* output_tree_ = nullptr;  // Owned by output_file_
+
+    // Merged timeframe and the (empty) run info written with every entry
+    HepMC3::GenEventData merged_event_;
+    HepMC3::GenEventData* merged_event_ptr_ = &merged_event_;
+    HepMC3::GenRunInfoData run_info_data_;
+    HepMC3::GenRunInfoData* run_info_data_ptr_ = &run_info_data_;
+
+    // Per sub-event topology and new particle ids (0: dropped), reused across events
+    HepMC3EventIndex event_index_;
+    std::vector<int> particle_index_;
+
+    // Per-source particle filters
+    HepMC3EventFilter filter_;
     
     // Store validated HepMC3 data sources (non-owning pointers)
     std::vector<HepMC3DataSource*> hepmc3_sources_;
-    
+
     // Speed of light constant: c = 299.792458 mm/ns
     // Used for converting time offsets (ns) to position offsets (mm) in HepMC3
     static constexpr double c_light = 299.792458;
 
+protected:
+    friend class FormatDataHandler<HepMC3DataHandler, HepMC3DataSource>;
+
     // Format-specific event processing
-    void processEvent(DataSource& source) override;
+    void processEvent(HepMC3DataSource& source);
 
-    // Helper methods
-    long insertHepMC3Event(const HepMC3::GenEvent& inevt,
-                          std::unique_ptr<HepMC3::GenEvent>& hepframe,
-                          double time,
-                          int baseStatus);
+    /**
+     * Append one sub-event to the merged timeframe
+     * Particle links are shifted by the number of merged particles and vertex links by the
+     * number of merged vertices. Vertex times are shifted by c*time; vertices without an
+     * explicit position first inherit it from their first incoming particle's production
+     * vertex (or the event position), as HepMC3::GenVertex::position() does. Particles
+     * attached to no vertex are dropped and attributes are not carried over.
+     * @param time Time offset in ns
+     * @param baseStatus Added to the status of every particle
+     * @return Number of final state (status 1) particles in the sub-event
+     */
+    long appendHepMC3Event(const HepMC3::GenEventData& inevt,
+                           HepMC3::GenEventData& frame,
+                           double time,
+                           int baseStatus);
 };
@@ -2,11 +2,18 @@
 
 #include "DataSource.h"
 #include "MergerConfig.h"
-#include <HepMC3/ReaderRootTree.h>
 #include <HepMC3/GenEvent.h>
+#include <HepMC3/GenRunInfo.h>
+#include <HepMC3/Data/GenEventData.h>
+#include <HepMC3/Data/GenRunInfoData.h>
 #include <HepMC3/GenVertex.h>
 #include <HepMC3/GenParticle.h>
+#include <TChain.h>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 #include <random>
@@ -17,8 +24,16 @@
  * 
  * Handles all HepMC3-specific logic for reading events from ROOT tree files
  * (.hepmc3.tree.root), applying time offsets, and providing data for merging.
+ * All input files are chained, and events are read by entry number, so
+ * sources can jump to any entry and wrap around with repeat_on_eof.
+ * Entries are kept in the flat GenEventData form the merge works on; the
+ * GenEvent graph is only built when getCurrentEvent() is called.
+ *
+ * With prefetching enabled, a background thread reads and decompresses the
+ * next entries into a bounded queue while the merge thread works on other
+ * sources; the queue recycles a fixed set of GenEventData buffers.
  */
-class HepMC3DataSource : public DataSource {
+class HepMC3DataSource final : public DataSource {
 public:
     HepMC3DataSource(const SourceConfig& config, size_t source_index);
     ~HepMC3DataSource();
@@ -30,25 +45,76 @@ public:
     // Event loading
     void loadEvent(size_t event_index) override;
 
+    // Beam vertex of the current event (public for the statically dispatched merge loop)
+    VertexPosition getBeamVertexPosition() const override;
+
+    /**
+     * Start reading ahead on a background thread
+     * Must be called before the first loadEvent; entries are expected in sequence,
+     * any other entry restarts the read-ahead there
+     * @param depth Number of decoded entries kept ahead of the merge
+     */
+    void startPrefetch(size_t depth);
+    void printPrefetchStatistics() const;
+
     // HepMC3-specific data access methods
-    const HepMC3::GenEvent& getCurrentEvent() const { return current_event_; }
+    const HepMC3::GenEventData& getCurrentEventData() const { return *event_data_; }
+    const HepMC3::GenEvent& getCurrentEvent() const;
     
     // Status and diagnostics
     void printStatus() const override;
-    bool isInitialized() const override { return reader_ != nullptr; }
+    bool isInitialized() const override { return chain_ != nullptr; }
+    void collectMemoryUsage(MemoryUsage& usage) const override;
     std::string getFormatName() const override { return "HepMC3"; }
 
 private:
-    // HepMC3 reader and state
-    std::shared_ptr<HepMC3::ReaderRootTree> reader_;
+    // Tree and branch names written by HepMC3::WriterRootTree
+    static constexpr const char* kTreeName = "hepmc3_tree";
+    static constexpr const char* kEventBranchName = "hepmc3_event";
+    static constexpr const char* kRunInfoBranchName = "GenRunInfo";
+
+    // Chain over all input files and its branch buffers
+    std::unique_ptr<TChain> chain_;
+    HepMC3::GenEventData* event_data_ = nullptr;
+    HepMC3::GenRunInfoData* run_info_data_ = nullptr;
+    int run_info_tree_number_ = -1;  // Tree whose GenRunInfo was last decoded
     
-    // Current event
-    HepMC3::GenEvent current_event_;
+    // Read-ahead queue: buffers cycle between free_buffers_, the worker and ready_
+    struct PrefetchedEntry {
+        size_t index;  // Entry index as requested (before wrapping around)
+        HepMC3::GenEventData* data;
+        std::shared_ptr<HepMC3::GenRunInfo> run_info;
+    };
+    std::thread prefetch_thread_;
+    mutable std::mutex prefetch_mutex_;
+    std::condition_variable prefetch_ready_;  // Signals the merge thread
+    std::condition_variable prefetch_free_;   // Signals the worker
+    std::deque<PrefetchedEntry> ready_;
+    std::vector<HepMC3::GenEventData*> free_buffers_;
+    HepMC3::GenEventData* prefetch_target_ = nullptr;  // Branch address while prefetching
+    std::shared_ptr<HepMC3::GenRunInfo> prefetch_run_info_;
+    size_t prefetch_depth_ = 0;
+    size_t prefetch_next_ = 0;      // Next index the worker reads
+    size_t prefetch_expected_ = 0;  // Next index the merge thread should ask for
+    bool prefetch_stop_ = false;
+    bool prefetch_done_ = false;    // Worker reached the end of the input or failed
+    std::string prefetch_error_;
+    size_t prefetch_hits_ = 0;      // Entries that were ready when requested
+    size_t prefetch_waits_ = 0;     // Entries the merge thread had to wait for
+    size_t prefetch_restarts_ = 0;
+
+    // Event graph of the current entry, built on demand
+    mutable HepMC3::GenEvent current_event_;
+    mutable bool current_event_valid_ = false;
+    std::shared_ptr<HepMC3::GenRunInfo> run_info_;
     
     // Private helper methods
     void openInputFiles();
     void cleanup();
-    
-    // Format-specific vertex extraction from HepMC3 events (overrides base class)
-    VertexPosition getBeamVertexPosition() const override;
+    size_t wrapEntry(size_t event_index) const;
+    void readEntry(size_t entry);
+    void takePrefetched(size_t event_index);
+    void prefetchLoop();
+    void launchPrefetch(size_t first_index);
+    void stopPrefetch();
 };
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "HepMC3EventIndex.h"
+#include "MergerConfig.h"
+#include <HepMC3/Data/GenEventData.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class HepMC3EventFilter
+ * @brief Per-source particle filters applied to HepMC3 sub-events before merging
+ *
+ * Shrinks a GenEventData according to the source configuration:
+ * - final_state_only keeps final state (status 1) and beam (status 4) particles only
+ * - min_momentum / max_abs_eta drop final state particles outside the acceptance
+ * - collapse_history implies final_state_only and merges the remaining vertices
+ *   that share a position, leaving one vertex per distinct production point
+ * Vertices left without particles are dropped, the remaining ones get explicit
+ * positions. Attributes are not carried over. The filtered event is written to a
+ * buffer reused across events.
+ */
+class HepMC3EventFilter {
+public:
+    /**
+     * Whether any filter is configured for the source
+     */
+    static bool enabled(const SourceConfig& config);
+
+    /**
+     * Filter an event; the result stays valid until the next call
+     */
+    const HepMC3::GenEventData& apply(const HepMC3::GenEventData& event, const SourceConfig& config);
+
+    void printStatistics() const;
+
+private:
+    struct Statistics {
+        size_t events = 0;
+        size_t particles_in = 0;
+        size_t particles_out = 0;
+        size_t vertices_in = 0;
+        size_t vertices_out = 0;
+    };
+
+    bool acceptParticle(const HepMC3::GenParticleData& particle, const SourceConfig& config,
+                        double momentum_scale) const;
+
+    HepMC3EventIndex event_index_;
+    HepMC3::GenEventData filtered_;
+    std::vector<int> particle_index_;  // New particle id (0: dropped)
+    std::vector<int> vertex_index_;    // New vertex id (0: dropped)
+
+    // Per source, in order of first use
+    std::vector<std::string> source_names_;
+    std::unordered_map<std::string, Statistics> statistics_;
+};
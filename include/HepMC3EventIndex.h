@@ -0,0 +1,68 @@
+#pragma once
+
+#include <HepMC3/Data/GenEventData.h>
+#include <HepMC3/FourVector.h>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+/**
+ * @class HepMC3EventIndex
+ * @brief Particle-vertex topology of a flat HepMC3::GenEventData
+ *
+ * Built from the links1/links2 arrays of one event: the production and end vertex
+ * of every particle, the incoming and outgoing particles of every vertex, and the
+ * vertex positions with unset (zero) positions inherited the way
+ * HepMC3::GenVertex::position() does. All arrays are reused across events.
+ * Particles and vertices are addressed by their 0-based index in the event arrays.
+ */
+class HepMC3EventIndex {
+public:
+    /**
+     * Index the links of an event; the event must outlive the queries
+     */
+    void build(const HepMC3::GenEventData& event);
+
+    // Production / end vertex index of a particle, -1 if it has none
+    int productionVertex(size_t particle) const { return production_vertex_[particle]; }
+    int endVertex(size_t particle) const { return end_vertex_[particle]; }
+
+    // Particles attached to no vertex are not part of the event graph
+    bool isAttached(size_t particle) const {
+        return production_vertex_[particle] >= 0 || end_vertex_[particle] >= 0;
+    }
+
+    // Particle indices entering / leaving a vertex, in link order
+    std::span<const int> incoming(size_t vertex) const {
+        return {incoming_.data() + incoming_begin_[vertex], incoming_.data() + incoming_begin_[vertex + 1]};
+    }
+    std::span<const int> outgoing(size_t vertex) const {
+        return {outgoing_.data() + outgoing_begin_[vertex], outgoing_.data() + outgoing_begin_[vertex + 1]};
+    }
+
+    /**
+     * Position of a vertex; an unset position is taken from the production vertex of its
+     * first incoming particle, or from the event position
+     */
+    const HepMC3::FourVector& vertexPosition(size_t vertex);
+
+    // Links skipped because they do not connect a valid particle and vertex
+    size_t getInvalidLinks() const { return invalid_links_; }
+
+private:
+    const HepMC3::GenEventData* event_ = nullptr;
+    std::vector<int> production_vertex_;
+    std::vector<int> end_vertex_;
+
+    // Incoming and outgoing particles per vertex (offsets into the flat arrays)
+    std::vector<int> incoming_begin_;
+    std::vector<int> incoming_;
+    std::vector<int> outgoing_begin_;
+    std::vector<int> outgoing_;
+    std::vector<int> incoming_scratch_;  // Fill cursors while building
+    std::vector<int> outgoing_scratch_;
+
+    std::vector<HepMC3::FourVector> vertex_position_;
+    std::vector<char> vertex_state_;  // 0: unresolved, 1: resolving, 2: resolved
+    size_t invalid_links_ = 0;
+};
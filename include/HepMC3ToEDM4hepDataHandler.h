@@ -0,0 +1,92 @@
+#pragma once
+
+#include "EDM4hepDataHandler.h"
+#include "FormatDataHandler.h"
+#include "HepMC3DataSource.h"
+#include "HepMC3EventFilter.h"
+#include "HepMC3EventIndex.h"
+#include <podio/CollectionIDTable.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class HepMC3ToEDM4hepDataHandler
+ * @brief Merges HepMC3 input into EDM4hep MCParticle timeframes
+ *
+ * Reads HepMC3 sources like HepMC3DataHandler, but converts every sub-event straight
+ * into edm4hep::MCParticleData with parent/daughter ObjectID references and writes
+ * the EDM4hepDataHandler output layout (EventHeader, SubEventHeaders, MCParticles).
+ * This replaces a separate HepMC3 to EDM4hep conversion pass over the merged files.
+ *
+ * Particle times are the production vertex time converted to ns plus the sub-event
+ * time offset; positions are converted to mm and momenta and masses to GeV. Charges
+ * come from TDatabasePDG. Since there is no EDM4hep input to copy it from, a minimal
+ * podio_metadata tree (collection IDs and types, podio version, EDM definition) is
+ * written so podio readers can open the file.
+ */
+class HepMC3ToEDM4hepDataHandler : public FormatDataHandler<HepMC3ToEDM4hepDataHandler, HepMC3DataSource> {
+public:
+    HepMC3ToEDM4hepDataHandler() = default;
+    ~HepMC3ToEDM4hepDataHandler() override = default;
+
+    std::vector<std::unique_ptr<DataSource>> initializeDataSources(
+        const std::string& filename,
+        const std::vector<SourceConfig>& source_configs) override;
+
+    void prepareTimeframe() override;
+
+    void writeTimeframe() override;
+
+    void finalize() override;
+
+    void collectMemoryUsage(MemoryUsage& usage) const override;
+
+    std::string getFormatName() const override { return "HepMC3 to EDM4hep"; }
+
+protected:
+    friend class FormatDataHandler<HepMC3ToEDM4hepDataHandler, HepMC3DataSource>;
+
+    // Format-specific event processing
+    void processEvent(HepMC3DataSource& source);
+
+    /**
+     * Convert one HepMC3 sub-event and append it to the merged MCParticles
+     * @param time Time offset in ns
+     * @param baseStatus Added to the generator status of every particle
+     */
+    void appendMCParticles(const HepMC3::GenEventData& event, double time, int baseStatus);
+
+private:
+    std::unique_ptr<TFile> output_file_;
+    TTree* output_tree_ = nullptr;  // Owned by output_file_
+    EDM4hepMergedCollections collections_;
+
+    // Store validated HepMC3 data sources (non-owning pointers)
+    std::vector<HepMC3DataSource*> hepmc3_sources_;
+
+    // Collection IDs of the output collections, also written to podio_metadata
+    podio::CollectionIDTable id_table_;
+    uint32_t mcparticles_collection_id_ = 0;
+
+    // Per sub-event topology, reused across events
+    HepMC3EventIndex event_index_;
+
+    // Per-source particle filters
+    HepMC3EventFilter filter_;
+
+    // Charge per PDG code, looked up once in TDatabasePDG
+    std::unordered_map<int, float> charges_;
+
+    // Sub-events merged so far (SubEventHeader event numbers)
+    int sub_events_consumed_ = 0;
+
+    // Speed of light in mm/ns, converts vertex times from mm to ns
+    static constexpr double c_light = 299.792458;
+
+    float chargeOf(int pdg);
+    void writePodioMetadata();
+};
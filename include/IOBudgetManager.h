@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class TChain;
+
+/**
+ * @class IOBudgetManager
+ * @brief Splits a global read cache budget across the input chains
+ *
+ * Each chain's TTreeCache is sized in proportion to its expected read volume:
+ * the expected number of entries read per timeframe times the compressed bytes
+ * per entry. A chain never gets more than its compressed tree size, and the
+ * unused share is redistributed. When rebalancing is enabled, the weights are
+ * periodically updated from the bytes each chain actually read and the miss
+ * rate of its cache, so chains that read more or miss more get a larger share.
+ */
+class IOBudgetManager {
+public:
+    /**
+     * @param budget_bytes Total TTreeCache budget across all chains
+     * @param rebalance_interval Timeframes between rebalances (0: static allocation)
+     */
+    IOBudgetManager(size_t budget_bytes, size_t rebalance_interval);
+
+    /**
+     * Register a chain with its expected number of entries read per timeframe
+     * A chain shared by several sources is registered once per source; rates add up
+     */
+    void addChain(TChain* chain, const std::string& name, double entries_per_timeframe);
+
+    /**
+     * Register another chain reading the files of a registered chain (a chunk reader of the
+     * parallel gather). The chain's share is split evenly across it and its readers; the new
+     * reader gets its part at once, the others are resized at the next endTimeframe.
+     * Safe to call while other chains are being read
+     */
+    void addReaderChain(TChain* chain, TChain* reader_chain);
+
+    /**
+     * Compute the initial allocation from the expected read volumes and apply it
+     */
+    void allocate();
+
+    /**
+     * Count a finished timeframe and rebalance every rebalance_interval timeframes
+     */
+    void endTimeframe();
+
+    void printAllocation() const;
+
+private:
+    // Bytes read position of a chain, to measure the bytes read between rebalances
+    struct ReadPosition {
+        long long last_bytes_read = 0;  // TFile::GetBytesRead at the last rebalance
+        std::string last_file;          // File the bytes read refer to
+    };
+
+    struct ChainBudget {
+        TChain* chain = nullptr;
+        std::string name;
+        double entries_per_timeframe = 0.0;
+        double bytes_per_entry = 0.0;   // Compressed bytes per entry of the current tree
+        size_t max_bytes = 0;           // Compressed size of the current tree
+        double weight = 0.0;
+        size_t cache_bytes = 0;
+        ReadPosition position;
+        // Further chains over the same files sharing cache_bytes with chain
+        std::vector<std::pair<TChain*, ReadPosition>> readers;
+    };
+
+    // Split the budget in proportion to the weights, capping each chain at max_bytes
+    void distribute();
+    void apply(ChainBudget& budget, size_t cache_bytes, bool force = false);
+    void rebalance();
+    // Bytes the chain read since the last call
+    static long long bytesReadSince(TChain* chain, ReadPosition& position);
+
+    size_t budget_bytes_;
+    size_t rebalance_interval_;
+    size_t timeframes_since_rebalance_ = 0;
+    size_t n_rebalances_ = 0;
+    std::vector<ChainBudget> chains_;
+    std::mutex mutex_;            // Guards chains_ against addReaderChain from gather threads
+    bool resplit_pending_ = false;  // Readers were added since the last endTimeframe
+};
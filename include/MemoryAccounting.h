@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class TTree;
+
+/**
+ * @struct MemoryUsageEntry
+ * @brief Size and capacity in bytes of one accounted buffer
+ */
+struct MemoryUsageEntry {
+    std::string owner;     // "merged", "output" or the source name
+    std::string category;  // e.g. "collection", "branch_buffer", "ttree_baskets", "ttree_cache", "hepmc3_event"
+    std::string name;      // Collection or branch name
+    size_t size_bytes = 0;
+    size_t capacity_bytes = 0;
+};
+
+using MemoryUsage = std::vector<MemoryUsageEntry>;
+
+namespace memory_accounting {
+
+// Heap bytes held by the elements themselves (nested vectors and strings)
+template <typename T>
+inline size_t elementHeapBytes(const T&) { return 0; }
+
+inline size_t elementHeapBytes(const std::string& value) {
+    // Short strings live in the object itself
+    return value.capacity() > 15 ? value.capacity() + 1 : 0;
+}
+
+template <typename T>
+inline size_t elementHeapBytes(const std::vector<T>& vec) {
+    size_t bytes = vec.capacity() * sizeof(T);
+    for (const auto& element : vec) {
+        bytes += elementHeapBytes(element);
+    }
+    return bytes;
+}
+
+/**
+ * Append the size and capacity of a vector (including nested heap data) to the usage list
+ */
+template <typename T>
+inline void accountVector(MemoryUsage& usage, const std::string& owner, const std::string& category,
+                          const std::string& name, const std::vector<T>& vec) {
+    size_t nested = 0;
+    for (const auto& element : vec) {
+        nested += elementHeapBytes(element);
+    }
+    usage.push_back({owner, category, name, vec.size() * sizeof(T) + nested, vec.capacity() * sizeof(T) + nested});
+}
+
+/**
+ * Append the in-memory basket buffers of every top-level branch of a tree
+ * and the size of its TTreeCache (if any)
+ */
+void accountTree(MemoryUsage& usage, const std::string& owner, TTree* tree);
+
+/**
+ * Current resident set size of this process in bytes (0 if unavailable)
+ */
+size_t currentRSSBytes();
+
+/**
+ * Escape a string for use inside a JSON string literal: quotes, backslashes and
+ * control characters (as \n, \t, ... or \u00XX)
+ */
+std::string jsonEscape(const std::string& value);
+
+} // namespace memory_accounting
+
+/**
+ * @class MemoryAccountant
+ * @brief Tracks accounted memory per timeframe and keeps the breakdown at peak
+ */
+class MemoryAccountant {
+public:
+    /**
+     * Open a CSV time series with one row per timeframe, owner and category
+     * @param filename Output CSV path
+     */
+    void openTimeSeries(const std::string& filename);
+
+    /**
+     * Record the usage of one timeframe, update the peak and print a one line summary
+     */
+    void record(size_t timeframe, MemoryUsage usage);
+
+    /**
+     * Print the breakdown at peak, aggregated per owner and category plus the largest buffers
+     */
+    void printSummary() const;
+
+    /**
+     * Write the peak breakdown as a JSON object (used in the run report)
+     */
+    void writeJson(std::ostream& os) const;
+
+private:
+    size_t peak_capacity_bytes_ = 0;
+    size_t peak_timeframe_ = 0;
+    size_t peak_rss_bytes_ = 0;
+    MemoryUsage peak_usage_;
+    std::ofstream timeseries_;
+};
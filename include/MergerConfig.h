@@ -3,6 +3,13 @@
 #include <string>
 #include <vector>
 
+// Acceptance window of a tracker or calorimeter collection, in ns from the timeframe start
+struct CollectionTimeWindow {
+    std::string collection;  // "*" for every collection without a window of its own
+    float t_min{0.0f};
+    float t_max{0.0f};
+};
+
 struct MergerConfig {
     bool   introduce_offsets{true};
     float  timeframe_duration{2000.0f};
@@ -16,6 +23,65 @@ struct MergerConfig {
     std::string output_file{"merged_timeframes.edm4hep.root"};
     size_t max_events{100};
     bool   merge_particles{false};
+
+    // Output compression (EDM4hep output): zlib, lzma, lz4 or zstd
+    std::string compression_algorithm{"zlib"};
+    int    compression_level{1};
+
+    // ROOT implicit multi-threading (0 disables it)
+    unsigned int n_threads{0};
+
+    // Read and process the sources of a timeframe concurrently (EDM4hep output)
+    bool   parallel_sources{false};
+    unsigned int merge_threads{0};  // Threads of the parallel merge (0: one per source, up to the hardware threads)
+    size_t chunk_entries{0};        // Split sources into chunks of this many entries read concurrently (0: no split)
+
+    // Fork this many worker processes writing shards that are concatenated into output_file (0 or 1: single process)
+    unsigned int processes{0};
+    size_t first_timeframe{0};  // Number of the first timeframe written (set per worker by --processes)
+
+    // Write every background timeframe this many times, each with new events of the is_signal
+    // sources overlaid (0 or 1: off, EDM4hep output)
+    size_t signal_multiplex{0};
+
+    // Leave particle and hit times unshifted and write the offsets per sub-event (EDM4hep output)
+    bool lazy_time_offsets{false};
+
+    // Hits and calorimeter contributions outside the window of their collection are dropped
+    // before writing (EDM4hep output); later windows of a collection override earlier ones
+    std::vector<CollectionTimeWindow> time_windows;
+
+    // Write every tracker hit and calorimeter collection sorted by time (EDM4hep output)
+    bool sort_by_time{false};
+
+    // Combine the calorimeter hits of one cell from all sub-events of a timeframe into one hit (EDM4hep output)
+    bool calo_pileup{false};
+
+    // Machine readable run report (JSON), empty to disable
+    std::string report_file{""};
+
+    // Share decode buffers between EDM4hep sources with identical schemas
+    bool   share_source_buffers{false};
+
+    // Share one reader (TChain) between EDM4hep sources reading the same files
+    bool   share_input_readers{false};
+    size_t decode_cache_entries{16};  // Decoded entries cached per shared reader (0 disables it)
+
+    // Global TTreeCache budget split across the input chains by expected read volume (0: ROOT defaults)
+    float  io_memory_budget_mb{0.0f};
+    size_t io_rebalance_interval{0};  // Timeframes between rebalances from observed reads (0: static)
+
+    // Adaptive capacity of the merged collections (EDM4hep output)
+    bool   capacity_policy{false};
+    size_t capacity_window{50};        // Recent timeframe sizes kept per vector
+    float  capacity_quantile{0.9f};    // Quantile of the recent sizes the capacity tracks
+    float  capacity_headroom{1.2f};    // Multiplier applied to the quantile
+    size_t capacity_shrink_after{10};  // Consecutive oversized timeframes before shrinking
+    float  memory_cap_mb{0.0f};        // Cap on the retained capacity of the merged collections (0: no cap)
+
+    // Per-timeframe accounting of buffer, basket and cache memory
+    bool   memory_accounting{false};
+    std::string memory_timeseries_file{""};  // Optional CSV time series, empty to disable
 };
 
 struct SourceConfig {
@@ -41,4 +107,27 @@ struct SourceConfig {
     // Tree properties
     std::string tree_name{"events"};
     bool repeat_on_eof{false};
+
+    // Read-ahead on a background thread (HepMC3 input)
+    bool   prefetch{false};
+    size_t prefetch_depth{0};  // Entries kept decoded ahead (0: mean + 3 sigma of the entries per timeframe)
+
+    // Particle filters applied before merging (HepMC3 input)
+    bool  final_state_only{false};  // Keep final state and beam particles only
+    float min_momentum{0.0f};       // GeV, final state particles below are dropped (0: no cut)
+    float max_abs_eta{0.0f};        // Final state particles with larger |eta| are dropped (0: no cut)
+    bool  collapse_history{false};  // Final state only, one vertex per production point
+
+    // Overlaid on every copy of a background timeframe with signal_multiplex
+    bool  is_signal{false};
+
+    // Pre-merged bundles of bundle_size consecutive events of this source (EDM4hep input). The
+    // entries drawn per timeframe are read as whole bundles from bundle_files plus the remainder
+    // from input_files; CommandLineParser adds a "<name>_bundles" source reading the bundles
+    std::vector<std::string> bundle_files;
+    size_t bundle_size{0};
+
+    // Read only part entry_part of the input split in entry_parts equal ranges (set per worker by --processes)
+    size_t entry_part{0};
+    size_t entry_parts{1};
 };
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "MergerConfig.h"
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @class MultiProcessRunner
+ * @brief Runs the timeframe builder in forked worker processes and concatenates their output
+ *
+ * Worker k of N reads part k of every source (see DataSource::restrictToEntryPart),
+ * builds its share of max_events numbered from its first timeframe, with a seed
+ * derived from random_seed and k, and writes a shard file next to output_file. Its
+ * console output goes to <shard>.log. Once all workers succeeded, the shards are
+ * concatenated into output_file (see timeframe_concat::concatenate) and removed.
+ * The workers share nothing but the input files, so this scales across the cores
+ * of a node without relying on ROOT's thread safety.
+ */
+class MultiProcessRunner {
+public:
+    explicit MultiProcessRunner(const MergerConfig& config);
+
+    /**
+     * Fork the workers, wait for them and concatenate their shards
+     * @throws std::runtime_error if a worker cannot be started or fails
+     */
+    void run();
+
+private:
+    struct Worker {
+        MergerConfig config;
+        std::string log_file;
+        pid_t pid = -1;
+    };
+
+    // Configuration of worker index: its entry part, timeframes, seed and shard file
+    MergerConfig workerConfig(size_t index, size_t n_workers, size_t first_timeframe,
+                              size_t timeframes, unsigned int seed) const;
+
+    // Build the worker's timeframes in the forked child, returns its exit code
+    static int runWorker(const Worker& worker);
+
+    MergerConfig config_;
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Stable LSD radix sort of element positions by a float key
+ *
+ * sortedOrder maps the keys to order-preserving 32 bit integers and sorts them in up to
+ * four passes of 8 bits; one read pass builds the histograms of all four bytes, and passes
+ * where every key has the same byte (e.g. the high bytes of times within one timeframe)
+ * are skipped. The result is the permutation order with element order[i] at position i,
+ * which applyOrder applies to the collection and any vectors parallel to it.
+ *
+ * sortedOrderParallel and applyOrderParallel do the same work split into contiguous
+ * blocks, run through a parallel_for(n_blocks, task) callable, for collections large
+ * enough to keep several threads busy on their own.
+ */
+namespace radix_sort {
+
+// Buffers reused from one sort to the next
+struct Scratch {
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> keys_tmp;
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> order_tmp;
+    std::vector<std::array<uint32_t, 256>> block_counts;  // Per block and pass, parallel sort only
+};
+
+// Elements [first, second) of block b when n elements are split into n_blocks
+inline std::pair<size_t, size_t> blockRange(size_t n, size_t n_blocks, size_t b) {
+    const size_t block_size = (n + n_blocks - 1) / n_blocks;
+    return {std::min(n, b * block_size), std::min(n, (b + 1) * block_size)};
+}
+
+// Unsigned integer with the order of the float: negatives are inverted, positives get the sign bit
+inline uint32_t floatKey(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits ^ ((bits >> 31) ? 0xFFFFFFFFu : 0x80000000u);
+}
+
+/**
+ * Permutation sorting elements by key(element), stable for equal keys
+ * @return scratch.order, valid until the next sort with the same scratch
+ */
+template <typename T, typename Key>
+const std::vector<uint32_t>& sortedOrder(const std::vector<T>& elements, Key&& key, Scratch& scratch) {
+    const size_t n = elements.size();
+    auto& keys = scratch.keys;
+    auto& order = scratch.order;
+    keys.resize(n);
+    order.resize(n);
+
+    std::array<std::array<uint32_t, 256>, 4> counts{};
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t k = floatKey(key(elements[i]));
+        keys[i] = k;
+        order[i] = static_cast<uint32_t>(i);
+        ++counts[0][k & 0xFF];
+        ++counts[1][(k >> 8) & 0xFF];
+        ++counts[2][(k >> 16) & 0xFF];
+        ++counts[3][k >> 24];
+    }
+
+    scratch.keys_tmp.resize(n);
+    scratch.order_tmp.resize(n);
+    for (unsigned pass = 0; pass < 4; ++pass) {
+        auto& count = counts[pass];
+        const unsigned shift = pass * 8;
+        if (n == 0 || count[(keys[0] >> shift) & 0xFF] == n) continue;
+
+        // Bucket starts, then a stable scatter of keys and positions
+        uint32_t start = 0;
+        for (auto& c : count) {
+            const uint32_t size = c;
+            c = start;
+            start += size;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t target = count[(keys[i] >> shift) & 0xFF]++;
+            scratch.keys_tmp[target] = keys[i];
+            scratch.order_tmp[target] = order[i];
+        }
+        keys.swap(scratch.keys_tmp);
+        order.swap(scratch.order_tmp);
+    }
+    return order;
+}
+
+/**
+ * sortedOrder with the keys, histograms and scatters of every pass split into n_blocks
+ * contiguous blocks run by parallel_for(n_blocks, task(block)). Each block counts its own
+ * histogram; the bucket starts are laid out bucket by bucket, block by block, so blocks
+ * scatter independently and the result equals that of sortedOrder.
+ * @return scratch.order, valid until the next sort with the same scratch
+ */
+template <typename T, typename Key, typename ParallelFor>
+const std::vector<uint32_t>& sortedOrderParallel(const std::vector<T>& elements, Key&& key, Scratch& scratch,
+                                                 size_t n_blocks, ParallelFor&& parallel_for) {
+    const size_t n = elements.size();
+    n_blocks = std::max<size_t>(1, std::min(n_blocks, n));
+    auto& keys = scratch.keys;
+    auto& order = scratch.order;
+    auto& block_counts = scratch.block_counts;
+    keys.resize(n);
+    order.resize(n);
+    scratch.keys_tmp.resize(n);
+    scratch.order_tmp.resize(n);
+    block_counts.assign(n_blocks * 4, std::array<uint32_t, 256>{});
+
+    parallel_for(n_blocks, [&](size_t b) {
+        auto* counts = &block_counts[b * 4];
+        const auto range = blockRange(n, n_blocks, b);
+        for (size_t i = range.first; i < range.second; ++i) {
+            const uint32_t k = floatKey(key(elements[i]));
+            keys[i] = k;
+            order[i] = static_cast<uint32_t>(i);
+            ++counts[0][k & 0xFF];
+            ++counts[1][(k >> 8) & 0xFF];
+            ++counts[2][(k >> 16) & 0xFF];
+            ++counts[3][k >> 24];
+        }
+    });
+    std::array<std::array<uint32_t, 256>, 4> totals{};
+    for (size_t b = 0; b < n_blocks; ++b) {
+        for (unsigned pass = 0; pass < 4; ++pass) {
+            for (unsigned d = 0; d < 256; ++d) {
+                totals[pass][d] += block_counts[b * 4 + pass][d];
+            }
+        }
+    }
+
+    bool permuted = false;
+    for (unsigned pass = 0; pass < 4; ++pass) {
+        const unsigned shift = pass * 8;
+        if (n == 0 || totals[pass][(keys[0] >> shift) & 0xFF] == n) continue;
+
+        // The block histograms of the first read only hold until the keys move
+        if (permuted) {
+            parallel_for(n_blocks, [&](size_t b) {
+                auto& count = block_counts[b * 4 + pass];
+                count.fill(0);
+                const auto range = blockRange(n, n_blocks, b);
+                for (size_t i = range.first; i < range.second; ++i) {
+                    ++count[(keys[i] >> shift) & 0xFF];
+                }
+            });
+        }
+
+        uint32_t start = 0;
+        for (unsigned d = 0; d < 256; ++d) {
+            for (size_t b = 0; b < n_blocks; ++b) {
+                auto& c = block_counts[b * 4 + pass][d];
+                const uint32_t size = c;
+                c = start;
+                start += size;
+            }
+        }
+        parallel_for(n_blocks, [&](size_t b) {
+            auto& count = block_counts[b * 4 + pass];
+            const auto range = blockRange(n, n_blocks, b);
+            for (size_t i = range.first; i < range.second; ++i) {
+                const uint32_t target = count[(keys[i] >> shift) & 0xFF]++;
+                scratch.keys_tmp[target] = keys[i];
+                scratch.order_tmp[target] = order[i];
+            }
+        });
+        keys.swap(scratch.keys_tmp);
+        order.swap(scratch.order_tmp);
+        permuted = true;
+    }
+    return order;
+}
+
+/**
+ * Reorder elements in place so that position i holds the former element order[i],
+ * following the cycles of the permutation
+ * @param visited Scratch marks, resized to the number of elements
+ */
+template <typename T>
+void applyOrder(std::vector<T>& elements, const std::vector<uint32_t>& order, std::vector<uint32_t>& visited) {
+    visited.assign(elements.size(), 0);
+    for (size_t i = 0; i < elements.size(); ++i) {
+        if (visited[i] || order[i] == i) continue;
+        T first = elements[i];
+        size_t j = i;
+        while (true) {
+            visited[j] = 1;
+            const size_t next = order[j];
+            if (next == i) {
+                elements[j] = first;
+                break;
+            }
+            elements[j] = elements[next];
+            j = next;
+        }
+    }
+}
+
+/**
+ * applyOrder gathering from a copy of the elements, in n_blocks blocks run by
+ * parallel_for(n_blocks, task(block))
+ * @param buffer Scratch copy of the elements, keeps its capacity for the next call
+ */
+template <typename T, typename ParallelFor>
+void applyOrderParallel(std::vector<T>& elements, const std::vector<uint32_t>& order, std::vector<T>& buffer,
+                        size_t n_blocks, ParallelFor&& parallel_for) {
+    const size_t n = elements.size();
+    n_blocks = std::max<size_t>(1, std::min(n_blocks, n));
+    buffer.resize(n);
+    parallel_for(n_blocks, [&](size_t b) {
+        const auto range = blockRange(n, n_blocks, b);
+        std::copy(elements.begin() + range.first, elements.begin() + range.second, buffer.begin() + range.first);
+    });
+    parallel_for(n_blocks, [&](size_t b) {
+        const auto range = blockRange(n, n_blocks, b);
+        for (size_t i = range.first; i < range.second; ++i) {
+            elements[i] = buffer[order[i]];
+        }
+    });
+}
+
+}  // namespace radix_sort
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @class SubEventTimeOffsets
+ * @brief Reader-side access to the time offsets of timeframes written with lazy_time_offsets
+ *
+ * With lazy time offsets the merger leaves the times of MCParticles, SimTrackerHits and
+ * CaloHitContributions as they were in the input and writes, per timeframe:
+ * - offsetsBranch(): the offset still to add to the times of each sub-event, in merge
+ *   order; a pre-merged input counts as one sub-event with offset 0, its times being
+ *   shifted already
+ * - beginBranch(collection): the index of the first element of each sub-event in the
+ *   collection; a sub-event runs up to the begin of the next one
+ *
+ * Reading both branches of a collection alongside it:
+ *   SubEventTimeOffsets offsets(*time_offsets, *begins);
+ *   offsets.apply(*tracker_hits);              // shift all times in place
+ *   float t = hit.time + offsets.offset(i);    // or look up one element
+ */
+class SubEventTimeOffsets {
+public:
+    static std::string offsetsBranch() { return "_SubEventHeaders_timeOffset"; }
+    static std::string beginBranch(const std::string& collection) { return "_" + collection + "_subEventBegin"; }
+
+    SubEventTimeOffsets(const std::vector<float>& offsets, const std::vector<uint32_t>& begins)
+        : offsets_(offsets), begins_(begins) {}
+
+    // Offset of element index of the collection (0 before the first sub-event)
+    float offset(size_t index) const {
+        auto it = std::upper_bound(begins_.begin(), begins_.end(), index);
+        if (it == begins_.begin()) return 0.0f;
+        return offsets_[static_cast<size_t>(it - begins_.begin()) - 1];
+    }
+
+    // Add the offsets to the time member of every element, one sub-event range at a time
+    template <typename T>
+    void apply(std::vector<T>& elements) const {
+        for (size_t sub_event = 0; sub_event < begins_.size(); ++sub_event) {
+            const size_t begin = std::min<size_t>(begins_[sub_event], elements.size());
+            const size_t end = sub_event + 1 < begins_.size()
+                ? std::min<size_t>(begins_[sub_event + 1], elements.size()) : elements.size();
+            for (size_t i = begin; i < end; ++i) {
+                elements[i].time += offsets_[sub_event];
+            }
+        }
+    }
+
+private:
+    const std::vector<float>& offsets_;
+    const std::vector<uint32_t>& begins_;
+};
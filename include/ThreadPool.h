@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads running indexed tasks
+ *
+ * parallelFor(n, task) runs task(0) ... task(n-1) on the workers and the calling
+ * thread and returns once all of them finished. Tasks are handed out one at a time
+ * through an atomic counter, so tasks of uneven cost balance themselves. The first
+ * exception thrown by a task is rethrown in the caller.
+ */
+class ThreadPool {
+public:
+    /**
+     * @param n_threads Total number of threads running tasks, including the caller
+     */
+    explicit ThreadPool(size_t n_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void parallelFor(size_t n_tasks, const std::function<void(size_t)>& task);
+
+    // Threads running tasks, including the caller
+    size_t size() const { return workers_.size() + 1; }
+
+private:
+    void workerLoop();
+    void runTasks();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+
+    // Current parallelFor call, published under mutex_
+    const std::function<void(size_t)>* task_ = nullptr;
+    size_t n_tasks_ = 0;
+    size_t generation_ = 0;
+    size_t busy_workers_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+
+    std::atomic<size_t> next_task_{0};
+};
@@ -3,6 +3,7 @@
 #include "MergerConfig.h"
 #include "DataSource.h"
 #include "DataHandler.h"
+#include "MemoryAccounting.h"
 #include <random>
 #include <vector>
 #include <string>
@@ -41,10 +42,45 @@ private:
 
     // Data sources (managed by data handler)
     std::vector<std::unique_ptr<DataSource>> data_sources_;
+
+    // With signal multiplexing, data_sources_ is split into the background sources, merged
+    // once per background timeframe, and the is_signal sources, merged into every copy
+    std::vector<std::unique_ptr<DataSource>> background_sources_;
+    std::vector<std::unique_ptr<DataSource>> signal_sources_;
     
     // Data handler (format-specific)
     std::unique_ptr<DataHandler> data_handler_;
 
+    // Per-timeframe memory accounting (enabled by m_config.memory_accounting)
+    MemoryAccountant memory_accountant_;
+
+    // Wall-clock time spent in each stage of the run (seconds)
+    struct StageTimes {
+        double initialize = 0.0;  // Source and output initialization
+        double sample = 0.0;      // Drawing the number of events per source
+        double prepare = 0.0;     // Clearing buffers for a new timeframe
+        double merge = 0.0;       // Reading, time shifting and appending events
+        double write = 0.0;       // Filling the output tree
+        double finalize = 0.0;    // Writing and closing the output file
+    };
+
     // Core functionality methods
     bool updateInputNEvents(std::vector<std::unique_ptr<DataSource>>& sources);
+    bool memoryAccountingEnabled() const;
+
+    /**
+     * Move data_sources_ into background_sources_ and signal_sources_
+     * @throws std::runtime_error if the handler cannot multiplex or no source is a signal
+     */
+    void splitSignalSources();
+
+    /**
+     * Collect the memory usage of the data handler and all sources for one timeframe
+     */
+    void recordMemoryUsage(size_t timeframe);
+
+    /**
+     * Write the machine readable run report (JSON) to m_config.report_file
+     */
+    void writeRunReport(const StageTimes& stages, size_t timeframes, size_t events, double total_time) const;
 };
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class TFile;
+
+namespace timeframe_concat {
+
+/**
+ * Concatenate timeframe files written by timeframe_builder into one output file
+ *
+ * The timeframe tree ("events", or "hepmc3_tree" for HepMC3 output) of all inputs is
+ * fast-cloned basket by basket, without decompressing or recompressing, and the
+ * output keeps the compression settings of the first input. The metadata trees are
+ * copied once from the first input (see copyMetadataTrees). All inputs must share
+ * the branch layout of the first one.
+ *
+ * With renumber_headers, the EventHeader branch of EDM4hep files is left out of the
+ * basket copy and refilled with eventNumber and timeStamp set to the output entry,
+ * so timeframes of independently built files stay unique. Only that branch is
+ * decompressed.
+ *
+ * @return Number of timeframes written
+ * @throws std::runtime_error if an input cannot be read or the output cannot be written
+ */
+size_t concatenate(const std::vector<std::string>& input_files, const std::string& output_file,
+                   bool renumber_headers = true);
+
+/**
+ * Fast-clone the podio metadata trees (podio_metadata, runs, meta, metadata) found
+ * in source into output. They describe the collections and runs the timeframes were
+ * built from, which are the same for every file of a production, so one copy is kept.
+ * @return Number of trees copied
+ */
+size_t copyMetadataTrees(TFile& source, TFile& output);
+
+} // namespace timeframe_concat
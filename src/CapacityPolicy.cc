@@ -0,0 +1,82 @@
+#include "CapacityPolicy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+size_t CapacityManager::recordSize(VectorState& state, size_t size) {
+    size_t window = std::max<size_t>(policy_.window, 1);
+    if (state.history.size() < window) {
+        state.history.push_back(size);
+    } else {
+        state.history[state.next] = size;
+    }
+    state.next = (state.next + 1) % window;
+
+    scratch_.assign(state.history.begin(), state.history.end());
+    float quantile = std::clamp(policy_.quantile, 0.0f, 1.0f);
+    size_t rank = static_cast<size_t>(std::ceil(quantile * (scratch_.size() - 1)));
+    std::nth_element(scratch_.begin(), scratch_.begin() + rank, scratch_.end());
+
+    return static_cast<size_t>(std::ceil(scratch_[rank] * std::max(policy_.headroom, 1.0f)));
+}
+
+void CapacityManager::shrink(VectorState& state, size_t old_capacity, size_t new_capacity) {
+    state.shrink(new_capacity);
+    state.oversized_frames = 0;
+    released_bytes_ += (old_capacity - std::min(old_capacity, new_capacity)) * state.element_size;
+    ++n_shrinks_;
+}
+
+size_t CapacityManager::retainedBytes() const {
+    size_t total = 0;
+    for (const auto& [key, state] : states_) {
+        total += state.capacity_bytes;
+    }
+    return total;
+}
+
+void CapacityManager::enforceMemoryCap() {
+    if (policy_.memory_cap_bytes == 0) return;
+
+    size_t retained = retainedBytes();
+    if (retained <= policy_.memory_cap_bytes) return;
+
+    std::vector<VectorState*> candidates;
+    candidates.reserve(states_.size());
+    for (auto& [key, state] : states_) {
+        candidates.push_back(&state);
+    }
+
+    // First pass: bring the most oversized vectors down to their target
+    std::sort(candidates.begin(), candidates.end(), [](const VectorState* a, const VectorState* b) {
+        return a->capacity_bytes - std::min(a->capacity_bytes, a->target_bytes) >
+               b->capacity_bytes - std::min(b->capacity_bytes, b->target_bytes);
+    });
+    for (VectorState* state : candidates) {
+        if (retained <= policy_.memory_cap_bytes) return;
+        if (state->capacity_bytes <= state->target_bytes) break;
+        size_t target = state->target_bytes / state->element_size;
+        retained -= state->capacity_bytes - state->target_bytes;
+        shrink(*state, state->capacity_bytes / state->element_size, target);
+        state->capacity_bytes = state->target_bytes;
+    }
+
+    // Second pass: release the largest vectors completely
+    std::sort(candidates.begin(), candidates.end(), [](const VectorState* a, const VectorState* b) {
+        return a->capacity_bytes > b->capacity_bytes;
+    });
+    for (VectorState* state : candidates) {
+        if (retained <= policy_.memory_cap_bytes || state->capacity_bytes == 0) return;
+        retained -= state->capacity_bytes;
+        shrink(*state, state->capacity_bytes / state->element_size, 0);
+        state->capacity_bytes = 0;
+    }
+}
+
+void CapacityManager::printStatistics() const {
+    std::cout << "Capacity policy: " << n_shrinks_ << " shrinks, "
+              << released_bytes_ / (1024.0 * 1024.0) << " MB released, "
+              << retainedBytes() / (1024.0 * 1024.0) << " MB retained over "
+              << states_.size() << " vectors" << std::endl;
+}
@@ -15,6 +15,28 @@ void CommandLineParser::printUsage(const char* program_name) {
               << "  -d, --duration TIME         Timeframe duration in ns (default: 20.0)\n"
               << "  -p, --bunch-period PERIOD   Bunch crossing period in ns (default: 10.0)\n"
               << "  --random-seed SEED          Random number generator seed (default: 0, use random_device)\n"
+              << "  --threads N                 ROOT implicit multi-threading threads (default: 0, disabled)\n"
+              << "  --parallel-sources          Read and process the sources of a timeframe concurrently (EDM4hep output)\n"
+              << "  --merge-threads N           Threads for --parallel-sources (default: 0, one per source)\n"
+              << "  --chunk-entries N           Read sources in chunks of N entries on parallel threads (implies --parallel-sources)\n"
+              << "  --processes N               Fork N worker processes on disjoint input ranges and concatenate their output\n"
+              << "  --signal-multiplex K        Write every background timeframe K times with new signal events (EDM4hep output)\n"
+              << "  --lazy-time-offsets         Write time offsets per sub-event instead of shifting times (EDM4hep output)\n"
+              << "  --time-window COLL:MIN:MAX  Drop hits of collection COLL (* for all) outside [MIN, MAX] ns (repeatable)\n"
+              << "  --sort-by-time              Write tracker and calorimeter collections sorted by time (EDM4hep output)\n"
+              << "  --calo-pileup               Combine calorimeter hits of the same cell across sub-events (EDM4hep output)\n"
+              << "  --compression ALG           Output compression algorithm: zlib, lzma, lz4, zstd (default: zlib)\n"
+              << "  --compression-level N       Output compression level (default: 1)\n"
+              << "  --report FILE               Write a JSON run report with throughput and stage timings\n"
+              << "  --share-source-buffers      Share decode buffers between EDM4hep sources with the same schema\n"
+              << "  --share-input-readers       Share one reader between EDM4hep sources reading the same files\n"
+              << "  --decode-cache N            Decoded entries cached per shared reader (default: 16)\n"
+              << "  --io-budget MB              Total TTreeCache budget split across input chains by read volume\n"
+              << "  --io-rebalance N            Rebalance the I/O budget every N timeframes from observed reads\n"
+              << "  --capacity-policy           Shrink merged collections that stay above a rolling quantile of recent sizes\n"
+              << "  --memory-cap MB             Cap on the capacity retained by merged collections (implies --capacity-policy)\n"
+              << "  --memory-accounting         Report buffer, basket and cache memory per timeframe and at peak\n"
+              << "  --memory-timeseries FILE    Write the per-timeframe memory accounting as CSV (implies --memory-accounting)\n"
               << "  -h, --help                  Show this help message\n"
               << "\nDefault Source Options (backward compatibility):\n"
               << "  -f, --frequency FREQ        Mean event frequency (events/ns) (default: 1.0)\n"
@@ -47,6 +69,24 @@ void CommandLineParser::printUsage(const char* program_name) {
               << "                              Generator status offset\n"
               << "  --source:NAME:repeat_on_eof BOOL\n"
               << "                              Repeat source when EOF reached (true/false)\n"
+              << "  --source:NAME:prefetch BOOL\n"
+              << "                              Read ahead on a background thread (HepMC3 input)\n"
+              << "  --source:NAME:prefetch_depth N\n"
+              << "                              Entries read ahead (default: 0 = from the source rate)\n"
+              << "  --source:NAME:final_state_only BOOL\n"
+              << "                              Keep final state and beam particles only (HepMC3 input)\n"
+              << "  --source:NAME:min_momentum P\n"
+              << "                              Drop final state particles below P GeV (HepMC3 input)\n"
+              << "  --source:NAME:max_abs_eta ETA\n"
+              << "                              Drop final state particles beyond |eta| (HepMC3 input)\n"
+              << "  --source:NAME:collapse_history BOOL\n"
+              << "                              Final state only, merge vertices per production point (HepMC3 input)\n"
+              << "  --source:NAME:bundle_files FILE1,FILE2\n"
+              << "                              Pre-merged bundles of bundle_size events of this source\n"
+              << "  --source:NAME:bundle_size M\n"
+              << "                              Events per bundle, the remainder is read from input_files\n"
+              << "  --source:NAME:is_signal BOOL\n"
+              << "                              Overlay on every copy of the background with --signal-multiplex\n"
               << "\nExamples:\n"
               << "  # Create signal source with specific files and frequency\n"
               << "  " << program_name << " --source:signal:input_files signal1.edm4hep.root,signal2.edm4hep.root --source:signal:frequency 0.5\n"
@@ -139,6 +179,24 @@ bool CommandLineParser::handleSourceOption(std::vector<SourceConfig>& sources, c
         source->beam_angle = std::stof(value);
     } else if (property == "repeat_on_eof") {
         source->repeat_on_eof = parseBool(value);
+    } else if (property == "prefetch") {
+        source->prefetch = parseBool(value);
+    } else if (property == "prefetch_depth") {
+        source->prefetch_depth = std::stoul(value);
+    } else if (property == "final_state_only") {
+        source->final_state_only = parseBool(value);
+    } else if (property == "min_momentum") {
+        source->min_momentum = std::stof(value);
+    } else if (property == "max_abs_eta") {
+        source->max_abs_eta = std::stof(value);
+    } else if (property == "collapse_history") {
+        source->collapse_history = parseBool(value);
+    } else if (property == "bundle_files") {
+        source->bundle_files = splitCommaSeparated(value);
+    } else if (property == "bundle_size") {
+        source->bundle_size = std::stoul(value);
+    } else if (property == "is_signal") {
+        source->is_signal = parseBool(value);
     } else {
         std::cerr << "Warning: Unknown source property: " << property << std::endl;
         return false;
@@ -155,6 +213,41 @@ void CommandLineParser::loadYAMLConfig(const std::string& config_file, MergerCon
     if (yaml["bunch_crossing_period"]) config.bunch_crossing_period = yaml["bunch_crossing_period"].as<float>();
     if (yaml["random_seed"]) config.random_seed = yaml["random_seed"].as<unsigned int>();
     if (yaml["introduce_offsets"]) config.introduce_offsets = yaml["introduce_offsets"].as<bool>();
+    if (yaml["n_threads"]) config.n_threads = yaml["n_threads"].as<unsigned int>();
+    if (yaml["parallel_sources"]) config.parallel_sources = yaml["parallel_sources"].as<bool>();
+    if (yaml["merge_threads"]) config.merge_threads = yaml["merge_threads"].as<unsigned int>();
+    if (yaml["chunk_entries"]) config.chunk_entries = yaml["chunk_entries"].as<size_t>();
+    if (yaml["processes"]) config.processes = yaml["processes"].as<unsigned int>();
+    if (yaml["signal_multiplex"]) config.signal_multiplex = yaml["signal_multiplex"].as<size_t>();
+    if (yaml["lazy_time_offsets"]) config.lazy_time_offsets = yaml["lazy_time_offsets"].as<bool>();
+    if (yaml["sort_by_time"]) config.sort_by_time = yaml["sort_by_time"].as<bool>();
+    if (yaml["calo_pileup"]) config.calo_pileup = yaml["calo_pileup"].as<bool>();
+    if (yaml["time_windows"]) {
+        config.time_windows.clear();
+        for (const auto& window_yaml : yaml["time_windows"]) {
+            CollectionTimeWindow window;
+            window.collection = window_yaml["collection"].as<std::string>();
+            window.t_min = window_yaml["t_min"].as<float>();
+            window.t_max = window_yaml["t_max"].as<float>();
+            config.time_windows.push_back(window);
+        }
+    }
+    if (yaml["compression_algorithm"]) config.compression_algorithm = yaml["compression_algorithm"].as<std::string>();
+    if (yaml["compression_level"]) config.compression_level = yaml["compression_level"].as<int>();
+    if (yaml["report_file"]) config.report_file = yaml["report_file"].as<std::string>();
+    if (yaml["share_source_buffers"]) config.share_source_buffers = yaml["share_source_buffers"].as<bool>();
+    if (yaml["share_input_readers"]) config.share_input_readers = yaml["share_input_readers"].as<bool>();
+    if (yaml["decode_cache_entries"]) config.decode_cache_entries = yaml["decode_cache_entries"].as<size_t>();
+    if (yaml["io_memory_budget_mb"]) config.io_memory_budget_mb = yaml["io_memory_budget_mb"].as<float>();
+    if (yaml["io_rebalance_interval"]) config.io_rebalance_interval = yaml["io_rebalance_interval"].as<size_t>();
+    if (yaml["capacity_policy"]) config.capacity_policy = yaml["capacity_policy"].as<bool>();
+    if (yaml["capacity_window"]) config.capacity_window = yaml["capacity_window"].as<size_t>();
+    if (yaml["capacity_quantile"]) config.capacity_quantile = yaml["capacity_quantile"].as<float>();
+    if (yaml["capacity_headroom"]) config.capacity_headroom = yaml["capacity_headroom"].as<float>();
+    if (yaml["capacity_shrink_after"]) config.capacity_shrink_after = yaml["capacity_shrink_after"].as<size_t>();
+    if (yaml["memory_cap_mb"]) config.memory_cap_mb = yaml["memory_cap_mb"].as<float>();
+    if (yaml["memory_accounting"]) config.memory_accounting = yaml["memory_accounting"].as<bool>();
+    if (yaml["memory_timeseries_file"]) config.memory_timeseries_file = yaml["memory_timeseries_file"].as<std::string>();
     
     if (yaml["sources"]) {
         config.sources.clear();
@@ -177,6 +270,19 @@ void CommandLineParser::loadYAMLConfig(const std::string& config_file, MergerCon
             if (source_yaml["beam_spread"]) source.beam_spread = source_yaml["beam_spread"].as<float>();
             if (source_yaml["generator_status_offset"]) source.generator_status_offset = source_yaml["generator_status_offset"].as<int32_t>();
             if (source_yaml["repeat_on_eof"]) source.repeat_on_eof = source_yaml["repeat_on_eof"].as<bool>();
+            if (source_yaml["prefetch"]) source.prefetch = source_yaml["prefetch"].as<bool>();
+            if (source_yaml["prefetch_depth"]) source.prefetch_depth = source_yaml["prefetch_depth"].as<size_t>();
+            if (source_yaml["final_state_only"]) source.final_state_only = source_yaml["final_state_only"].as<bool>();
+            if (source_yaml["min_momentum"]) source.min_momentum = source_yaml["min_momentum"].as<float>();
+            if (source_yaml["max_abs_eta"]) source.max_abs_eta = source_yaml["max_abs_eta"].as<float>();
+            if (source_yaml["collapse_history"]) source.collapse_history = source_yaml["collapse_history"].as<bool>();
+            if (source_yaml["is_signal"]) source.is_signal = source_yaml["is_signal"].as<bool>();
+            if (source_yaml["bundle_files"]) {
+                for (const auto& f : source_yaml["bundle_files"]) {
+                    source.bundle_files.push_back(f.as<std::string>());
+                }
+            }
+            if (source_yaml["bundle_size"]) source.bundle_size = source_yaml["bundle_size"].as<size_t>();
             config.sources.push_back(source);
         }
     }
@@ -228,6 +334,33 @@ void CommandLineParser::mergeCliSources(MergerConfig& config, const std::vector<
                 if (cli_source.repeat_on_eof) {
                     existing_source.repeat_on_eof = cli_source.repeat_on_eof;
                 }
+                if (cli_source.prefetch) {
+                    existing_source.prefetch = cli_source.prefetch;
+                }
+                if (cli_source.prefetch_depth != 0) {
+                    existing_source.prefetch_depth = cli_source.prefetch_depth;
+                }
+                if (cli_source.final_state_only) {
+                    existing_source.final_state_only = cli_source.final_state_only;
+                }
+                if (cli_source.min_momentum != 0.0f) {
+                    existing_source.min_momentum = cli_source.min_momentum;
+                }
+                if (cli_source.max_abs_eta != 0.0f) {
+                    existing_source.max_abs_eta = cli_source.max_abs_eta;
+                }
+                if (cli_source.collapse_history) {
+                    existing_source.collapse_history = cli_source.collapse_history;
+                }
+                if (cli_source.is_signal) {
+                    existing_source.is_signal = cli_source.is_signal;
+                }
+                if (!cli_source.bundle_files.empty()) {
+                    existing_source.bundle_files = cli_source.bundle_files;
+                }
+                if (cli_source.bundle_size != 0) {
+                    existing_source.bundle_size = cli_source.bundle_size;
+                }
                 found = true;
                 break;
             }
@@ -255,6 +388,57 @@ void CommandLineParser::validateConfiguration(MergerConfig& config) {
     if (config.sources.empty()) {
         throw std::runtime_error("Error: No valid sources with input files specified");
     }
+
+    for (const auto& window : config.time_windows) {
+        if (!(window.t_min < window.t_max)) {
+            throw std::runtime_error("Error: time window of " + window.collection + " needs t_min < t_max");
+        }
+    }
+
+    // Sorting would scatter the sub-event ranges the lazy offsets are recorded for
+    if (config.sort_by_time && config.lazy_time_offsets) {
+        throw std::runtime_error("Error: --sort-by-time needs the times shifted, it cannot be combined with --lazy-time-offsets");
+    }
+
+    expandBundledSources(config);
+}
+
+CollectionTimeWindow CommandLineParser::parseTimeWindow(const std::string& value) {
+    const size_t max_pos = value.rfind(':');
+    const size_t min_pos = max_pos == std::string::npos || max_pos == 0 ? std::string::npos : value.rfind(':', max_pos - 1);
+    if (min_pos == std::string::npos || min_pos == 0) {
+        throw std::runtime_error("Error: --time-window expects COLLECTION:T_MIN:T_MAX, got '" + value + "'");
+    }
+    CollectionTimeWindow window;
+    window.collection = value.substr(0, min_pos);
+    window.t_min = std::stof(value.substr(min_pos + 1, max_pos - min_pos - 1));
+    window.t_max = std::stof(value.substr(max_pos + 1));
+    return window;
+}
+
+void CommandLineParser::expandBundledSources(MergerConfig& config) {
+    std::vector<SourceConfig> sources;
+    for (const auto& source : config.sources) {
+        if (source.bundle_files.empty() && source.bundle_size == 0) {
+            sources.push_back(source);
+            continue;
+        }
+        if (source.bundle_files.empty() || source.bundle_size < 2 || source.already_merged) {
+            throw std::runtime_error("Error: Source '" + source.name + "' needs bundle_files, a bundle_size of at "
+                                     "least 2 and already_merged false to read bundles");
+        }
+
+        // The bundles source right after its source takes the whole bundles of the entries drawn
+        // for it (TimeframeBuilder::updateInputNEvents); the time offsets are baked in
+        SourceConfig bundles = source;
+        bundles.name = source.name + "_bundles";
+        bundles.input_files = source.bundle_files;
+        bundles.already_merged = true;
+        bundles.bundle_files.clear();
+        sources.push_back(source);
+        sources.push_back(bundles);
+    }
+    config.sources = std::move(sources);
 }
 
 void CommandLineParser::printConfiguration(const MergerConfig& config) {
@@ -277,6 +461,25 @@ void CommandLineParser::printConfiguration(const MergerConfig& config) {
         std::cout << "  Beam spread: " << source.beam_spread << std::endl;
         std::cout << "  Generator status offset: " << source.generator_status_offset << std::endl;
         std::cout << "  Repeat on EOF: " << (source.repeat_on_eof ? "true" : "false") << std::endl;
+        if (source.prefetch) {
+            std::cout << "  Prefetch depth: " << source.prefetch_depth << (source.prefetch_depth == 0 ? " (from source rate)" : "") << std::endl;
+        }
+        if (source.is_signal) {
+            std::cout << "  Signal source: true" << std::endl;
+        }
+        if (source.bundle_size > 0) {
+            std::cout << "  Bundle size: " << source.bundle_size
+                      << (source.already_merged ? " (bundles)" : " (remainder)") << std::endl;
+        }
+        if (source.final_state_only || source.collapse_history) {
+            std::cout << "  Particle filter: " << (source.collapse_history ? "collapsed history" : "final state only") << std::endl;
+        }
+        if (source.min_momentum > 0.0f) {
+            std::cout << "  Min momentum: " << source.min_momentum << " GeV" << std::endl;
+        }
+        if (source.max_abs_eta > 0.0f) {
+            std::cout << "  Max |eta|: " << source.max_abs_eta << std::endl;
+        }
     }
     std::cout << "Output file: " << config.output_file << std::endl;
     std::cout << "Max events: " << config.max_events << std::endl;
@@ -284,6 +487,63 @@ void CommandLineParser::printConfiguration(const MergerConfig& config) {
     std::cout << "Bunch crossing period: " << config.bunch_crossing_period << " ns" << std::endl;
     std::cout << "Random seed: " << config.random_seed << (config.random_seed == 0 ? " (using random_device)" : "") << std::endl;
     std::cout << "Introduce offsets: " << (config.introduce_offsets ? "true" : "false") << std::endl;
+    std::cout << "Threads: " << config.n_threads << (config.n_threads == 0 ? " (implicit MT disabled)" : "") << std::endl;
+    std::cout << "Parallel sources: " << (config.parallel_sources ? "true" : "false");
+    if (config.parallel_sources) {
+        std::cout << " (" << (config.merge_threads == 0 ? std::string("one thread per source") : std::to_string(config.merge_threads) + " threads") << ")";
+    }
+    std::cout << std::endl;
+    if (config.chunk_entries > 0) {
+        std::cout << "Chunk entries: " << config.chunk_entries << std::endl;
+    }
+    if (config.processes > 1) {
+        std::cout << "Worker processes: " << config.processes << std::endl;
+    }
+    if (config.signal_multiplex > 1) {
+        std::cout << "Signal multiplex: " << config.signal_multiplex << " signal overlays per background timeframe" << std::endl;
+    }
+    if (config.lazy_time_offsets) {
+        std::cout << "Lazy time offsets: true" << std::endl;
+    }
+    if (config.sort_by_time) {
+        std::cout << "Sort by time: true" << std::endl;
+    }
+    if (config.calo_pileup) {
+        std::cout << "Calorimeter pile-up by cellID: true" << std::endl;
+    }
+    for (const auto& window : config.time_windows) {
+        std::cout << "Time window " << window.collection << ": [" << window.t_min << ", " << window.t_max << "] ns" << std::endl;
+    }
+    std::cout << "Compression: " << config.compression_algorithm << " level " << config.compression_level << std::endl;
+    if (!config.report_file.empty()) {
+        std::cout << "Run report: " << config.report_file << std::endl;
+    }
+    std::cout << "Share source buffers: " << (config.share_source_buffers ? "true" : "false") << std::endl;
+    std::cout << "Share input readers: " << (config.share_input_readers ? "true" : "false");
+    if (config.share_input_readers) {
+        std::cout << " (decode cache " << config.decode_cache_entries << " entries)";
+    }
+    std::cout << std::endl;
+    if (config.io_memory_budget_mb > 0.0f) {
+        std::cout << "I/O memory budget: " << config.io_memory_budget_mb << " MB";
+        if (config.io_rebalance_interval > 0) {
+            std::cout << " (rebalanced every " << config.io_rebalance_interval << " timeframes)";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "Capacity policy: " << (config.capacity_policy ? "true" : "false");
+    if (config.capacity_policy) {
+        std::cout << " (window " << config.capacity_window << ", quantile " << config.capacity_quantile
+                  << ", headroom " << config.capacity_headroom << ", shrink after " << config.capacity_shrink_after << ")";
+    }
+    std::cout << std::endl;
+    if (config.memory_cap_mb > 0.0f) {
+        std::cout << "Memory cap: " << config.memory_cap_mb << " MB" << std::endl;
+    }
+    std::cout << "Memory accounting: " << (config.memory_accounting ? "true" : "false") << std::endl;
+    if (!config.memory_timeseries_file.empty()) {
+        std::cout << "Memory time series: " << config.memory_timeseries_file << std::endl;
+    }
     std::cout << "================================================" << std::endl;
 }
 
@@ -292,6 +552,7 @@ MergerConfig CommandLineParser::parse(int argc, char* argv[]) {
     SourceConfig default_source; // Default source config
     std::string config_file = "";
     std::vector<SourceConfig> cli_sources; // Sources defined via CLI
+    std::vector<CollectionTimeWindow> cli_time_windows;
     
     // First pass: extract source-specific options and process them separately
     std::vector<char*> remaining_args;
@@ -332,6 +593,28 @@ MergerConfig CommandLineParser::parse(int argc, char* argv[]) {
         {"frequency", required_argument, 0, 'f'},
         {"bunch-period", required_argument, 0, 'p'},
         {"random-seed", required_argument, 0, 1005},
+        {"report", required_argument, 0, 1006},
+        {"threads", required_argument, 0, 1007},
+        {"compression", required_argument, 0, 1008},
+        {"compression-level", required_argument, 0, 1009},
+        {"memory-accounting", no_argument, 0, 1010},
+        {"capacity-policy", no_argument, 0, 1012},
+        {"share-source-buffers", no_argument, 0, 1014},
+        {"share-input-readers", no_argument, 0, 1015},
+        {"decode-cache", required_argument, 0, 1016},
+        {"io-budget", required_argument, 0, 1017},
+        {"io-rebalance", required_argument, 0, 1018},
+        {"parallel-sources", no_argument, 0, 1019},
+        {"merge-threads", required_argument, 0, 1020},
+        {"chunk-entries", required_argument, 0, 1021},
+        {"processes", required_argument, 0, 1022},
+        {"signal-multiplex", required_argument, 0, 1023},
+        {"lazy-time-offsets", no_argument, 0, 1024},
+        {"time-window", required_argument, 0, 1025},
+        {"sort-by-time", no_argument, 0, 1026},
+        {"calo-pileup", no_argument, 0, 1027},
+        {"memory-cap", required_argument, 0, 1013},
+        {"memory-timeseries", required_argument, 0, 1011},
         {"use-bunch-crossing", no_argument, 0, 'b'},
         {"static-events", no_argument, 0, 's'},
         {"events-per-frame", required_argument, 0, 'e'},
@@ -390,6 +673,75 @@ MergerConfig CommandLineParser::parse(int argc, char* argv[]) {
             case 1005:
                 config.random_seed = std::stoul(optarg);
                 break;
+            case 1006:
+                config.report_file = optarg;
+                break;
+            case 1007:
+                config.n_threads = std::stoul(optarg);
+                break;
+            case 1008:
+                config.compression_algorithm = optarg;
+                break;
+            case 1009:
+                config.compression_level = std::stoi(optarg);
+                break;
+            case 1010:
+                config.memory_accounting = true;
+                break;
+            case 1011:
+                config.memory_accounting = true;
+                config.memory_timeseries_file = optarg;
+                break;
+            case 1012:
+                config.capacity_policy = true;
+                break;
+            case 1013:
+                config.capacity_policy = true;
+                config.memory_cap_mb = std::stof(optarg);
+                break;
+            case 1014:
+                config.share_source_buffers = true;
+                break;
+            case 1015:
+                config.share_input_readers = true;
+                break;
+            case 1016:
+                config.decode_cache_entries = std::stoul(optarg);
+                break;
+            case 1017:
+                config.io_memory_budget_mb = std::stof(optarg);
+                break;
+            case 1018:
+                config.io_rebalance_interval = std::stoul(optarg);
+                break;
+            case 1019:
+                config.parallel_sources = true;
+                break;
+            case 1020:
+                config.merge_threads = std::stoul(optarg);
+                break;
+            case 1021:
+                config.parallel_sources = true;
+                config.chunk_entries = std::stoul(optarg);
+                break;
+            case 1022:
+                config.processes = std::stoul(optarg);
+                break;
+            case 1023:
+                config.signal_multiplex = std::stoul(optarg);
+                break;
+            case 1024:
+                config.lazy_time_offsets = true;
+                break;
+            case 1025:
+                cli_time_windows.push_back(parseTimeWindow(optarg));
+                break;
+            case 1026:
+                config.sort_by_time = true;
+                break;
+            case 1027:
+                config.calo_pileup = true;
+                break;
             case 'h':
                 printUsage(new_argv[0]);
                 std::exit(0);
@@ -406,6 +758,9 @@ MergerConfig CommandLineParser::parse(int argc, char* argv[]) {
     
     // Merge CLI sources with existing config sources
     mergeCliSources(config, cli_sources);
+
+    // CLI time windows come after the YAML ones and so override them
+    config.time_windows.insert(config.time_windows.end(), cli_time_windows.begin(), cli_time_windows.end());
     
     // Command-line input files override YAML - add to default source
     for (int i = optind; i < new_argc; i++) {
@@ -2,43 +2,132 @@
 #include "EDM4hepDataHandler.h"
 #ifdef HAVE_HEPMC3
 #include "HepMC3DataHandler.h"
+#include "HepMC3ToEDM4hepDataHandler.h"
 #endif
+#include <Compression.h>
+#include <algorithm>
+#include <iostream>
 #include <stdexcept>
+#include <thread>
 
-void DataHandler::mergeEvents(std::vector<std::unique_ptr<DataSource>>& sources,
-                              size_t timeframe_number,
-                              float timeframe_duration,
-                              float bunch_crossing_period,
-                              std::mt19937& gen) {
+size_t DataHandler::mergeEvents(std::vector<std::unique_ptr<DataSource>>& sources,
+                                size_t timeframe_number,
+                                float timeframe_duration,
+                                float bunch_crossing_period,
+                                std::mt19937& gen) {
     current_timeframe_number_ = timeframe_number;
+
+    if (config_ && ((config_->parallel_sources && sources.size() > 1) || config_->chunk_entries > 0) &&
+        supportsParallelGather()) {
+        size_t total_events_consumed = gatherEvents(sources, timeframe_duration, bunch_crossing_period, gen);
+        std::cout << "Total events consumed in timeframe " << timeframe_number
+                  << ": " << total_events_consumed << std::endl;
+        return total_events_consumed;
+    }
     
     size_t total_events_consumed = 0;
     // Iterate over all sources
     for (auto& source : sources) {
-        const auto& config = source->getConfig();
-        size_t entries_needed = source->getEntriesNeeded();
-        int events_consumed = 0;
-        
-        // Process each event from this source
-        for (size_t entry = 0; entry < entries_needed; ++entry) {
-            // Load and prepare the event
-            source->loadEvent(source->getCurrentEntryIndex());
-            source->UpdateTimeOffset(timeframe_duration, bunch_crossing_period, gen);
-            
-            // Call format-specific processing
-            processEvent(*source);
-            
-            source->setCurrentEntryIndex(source->getCurrentEntryIndex() + 1);
-            events_consumed++;
-        }
+        // Format-specific event loop
+        size_t events_consumed = mergeSource(*source, timeframe_duration, bunch_crossing_period, gen);
         total_events_consumed += events_consumed;
         
         std::cout << "Processed " << events_consumed << " events from source " 
-                  << config.name << std::endl;
+                  << source->getName() << std::endl;
     }
 
     std::cout << "Total events consumed in timeframe " << timeframe_number 
               << ": " << total_events_consumed << std::endl;
+
+    return total_events_consumed;
+}
+
+size_t DataHandler::gatherEvents(std::vector<std::unique_ptr<DataSource>>& sources,
+                                 float timeframe_duration,
+                                 float bunch_crossing_period,
+                                 std::mt19937& gen) {
+    if (!thread_pool_) {
+        size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t n_threads = config_->merge_threads > 0 ? config_->merge_threads
+                         : config_->chunk_entries > 0 ? hardware_threads
+                         : std::min(sources.size(), hardware_threads);
+        thread_pool_ = std::make_unique<ThreadPool>(n_threads);
+        std::cout << "Gathering sources in parallel on " << thread_pool_->size() << " threads" << std::endl;
+    }
+
+    // Time offsets do not depend on the event content, so they are drawn up front in the
+    // order a sequential merge draws them; the result is then the same as a sequential
+    // merge, whatever the number of threads and chunks
+    const size_t chunk_entries = config_->chunk_entries;
+    time_offset_draws_.resize(sources.size());
+    chunks_.clear();
+    std::vector<size_t> first_entries(sources.size());
+    for (size_t index = 0; index < sources.size(); ++index) {
+        auto& source = *sources[index];
+        const size_t entries_needed = source.getEntriesNeeded();
+        auto& draws = time_offset_draws_[index];
+        draws.resize(entries_needed);
+        for (auto& draw : draws) {
+            draw = source.drawTimeOffset(timeframe_duration, bunch_crossing_period, gen);
+        }
+
+        // Split sources needing many entries into chunks read concurrently
+        first_entries[index] = source.getCurrentEntryIndex();
+        const size_t chunk_size = chunk_entries > 0 ? chunk_entries : entries_needed;
+        for (size_t first = 0; first < entries_needed; first += chunk_size) {
+            chunks_.push_back({index, first_entries[index] + first, first, std::min(chunk_size, entries_needed - first)});
+        }
+    }
+
+    // Chunks are handed out one at a time, so threads finishing early take the next one
+    prepareStaging(sources, chunks_);
+    thread_pool_->parallelFor(chunks_.size(), [&](size_t slot) {
+        const auto& chunk = chunks_[slot];
+        std::span<const DataSource::TimeOffsetDraw> draws(time_offset_draws_[chunk.source]);
+        gatherChunk(slot, chunk, *sources[chunk.source], draws.subspan(chunk.first_draw, chunk.entries));
+    });
+    concatenateStaging();
+
+    size_t total_events_consumed = 0;
+    for (size_t index = 0; index < sources.size(); ++index) {
+        auto& source = *sources[index];
+        const size_t events_consumed = source.getEntriesNeeded();
+        source.setCurrentEntryIndex(first_entries[index] + events_consumed);
+        total_events_consumed += events_consumed;
+        std::cout << "Processed " << events_consumed << " events from source "
+                  << source.getName() << std::endl;
+    }
+    return total_events_consumed;
+}
+
+void DataHandler::gatherChunk(size_t slot,
+                              const GatherChunk& chunk,
+                              DataSource& source,
+                              std::span<const DataSource::TimeOffsetDraw> draws) {
+    throw std::runtime_error(getFormatName() + " data handler does not support parallel source gathering");
+}
+
+int DataHandler::getCompressionSettings() const {
+    if (!config_) {
+        // Historical default: zlib level 1
+        return ROOT::CompressionSettings(ROOT::RCompressionSetting::EAlgorithm::kZLIB, 1);
+    }
+
+    const std::string& algorithm = config_->compression_algorithm;
+    ROOT::RCompressionSetting::EAlgorithm::EValues root_algorithm;
+    if (algorithm == "zlib") {
+        root_algorithm = ROOT::RCompressionSetting::EAlgorithm::kZLIB;
+    } else if (algorithm == "lzma") {
+        root_algorithm = ROOT::RCompressionSetting::EAlgorithm::kLZMA;
+    } else if (algorithm == "lz4") {
+        root_algorithm = ROOT::RCompressionSetting::EAlgorithm::kLZ4;
+    } else if (algorithm == "zstd") {
+        root_algorithm = ROOT::RCompressionSetting::EAlgorithm::kZSTD;
+    } else {
+        throw std::runtime_error("Unknown compression algorithm: " + algorithm +
+                                 " (supported: zlib, lzma, lz4, zstd)");
+    }
+    return ROOT::CompressionSettings(root_algorithm, config_->compression_level);
 }
 
 std::unique_ptr<DataHandler> DataHandler::create(const std::string& filename) {
@@ -71,3 +160,32 @@ std::unique_ptr<DataHandler> DataHandler::create(const std::string& filename) {
 #endif
     throw std::runtime_error(error_msg);
 }
+
+std::unique_ptr<DataHandler> DataHandler::create(const std::string& filename,
+                                                 const std::vector<SourceConfig>& source_configs) {
+    // Helper lambda to check file extension
+    auto hasExtension = [](const std::string& filename, const std::string& ext) {
+        if (filename.length() < ext.length()) return false;
+        return filename.compare(filename.length() - ext.length(), ext.length(), ext) == 0;
+    };
+
+    size_t hepmc3_sources = 0;
+    for (const auto& source_config : source_configs) {
+        if (!source_config.input_files.empty() && hasExtension(source_config.input_files[0], ".hepmc3.tree.root")) {
+            ++hepmc3_sources;
+        }
+    }
+
+    if (hepmc3_sources > 0 && hasExtension(filename, ".edm4hep.root")) {
+        if (hepmc3_sources != source_configs.size()) {
+            throw std::runtime_error("Cannot mix HepMC3 and EDM4hep sources in one merge: " + filename);
+        }
+#ifdef HAVE_HEPMC3
+        return std::make_unique<HepMC3ToEDM4hepDataHandler>();
+#else
+        throw std::runtime_error("HepMC3 input requires HepMC3 support (HepMC3 library not found during build)");
+#endif
+    }
+
+    return create(filename);
+}
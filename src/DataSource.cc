@@ -1,53 +1,85 @@
 // DataSource.cc - Base class implementation for shared functionality
 #include "DataSource.h"
+#include <algorithm>
 #include <cmath>
+#include <iostream>
+#include <stdexcept>
 
-void DataSource::UpdateTimeOffset(float timeframe_duration,
-                                  float bunch_crossing_period,
-                                  std::mt19937& rng) {
-    float distance = 0.0f;
-    
-    // Calculate beam distance if needed (format-specific)
-    if (!getConfig().already_merged && getConfig().attach_to_beam) {
-        distance = calculateBeamDistance();
+void DataSource::restrictToEntryPart() {
+    const auto& config = getConfig();
+    if (config.entry_parts <= 1) return;
+    if (config.entry_part >= config.entry_parts) {
+        throw std::runtime_error("Source " + config.name + ": entry part " + std::to_string(config.entry_part) +
+                                 " out of range (" + std::to_string(config.entry_parts) + " parts)");
     }
-    
-    current_time_offset_ = generateTimeOffset(distance, timeframe_duration, bunch_crossing_period, rng);
+
+    // Equal ranges, the remainder spread over the first parts
+    const size_t size = total_entries_ / config.entry_parts;
+    const size_t remainder = total_entries_ % config.entry_parts;
+    entry_offset_ = config.entry_part * size + std::min(config.entry_part, remainder);
+    total_entries_ = size + (config.entry_part < remainder ? 1 : 0);
+    std::cout << "Source " << config.name << " reads entries " << entry_offset_ << " to "
+              << entry_offset_ + total_entries_ << " (part " << config.entry_part + 1 << " of "
+              << config.entry_parts << ")" << std::endl;
+}
+
+double DataSource::expectedEntriesPerTimeframe(float timeframe_duration) const {
+    const auto& config = getConfig();
+    if (config.already_merged && config.bundle_size == 0) {
+        return 1.0;
+    }
+    double entries = config.static_number_of_events ? static_cast<double>(config.static_events_per_timeframe)
+                                                    : config.mean_event_frequency * timeframe_duration;
+    if (config.bundle_size > 0) {
+        // Whole bundles, or a remainder of about half a bundle when the rate spans several
+        const double bundle_size = static_cast<double>(config.bundle_size);
+        entries = config.already_merged ? entries / bundle_size : std::min(entries, (bundle_size - 1.0) / 2.0);
+    }
+    return entries;
 }
 
-float DataSource::generateTimeOffset(float distance, float timeframe_duration, 
-                                     float bunch_crossing_period, std::mt19937& rng) const {
+DataSource::TimeOffsetDraw DataSource::drawTimeOffset(float timeframe_duration, float bunch_crossing_period,
+                                                      std::mt19937& rng) const {
     const auto& config = getConfig();
+    TimeOffsetDraw draw;
     
     std::uniform_real_distribution<float> uniform(0.0f, timeframe_duration);
-    float time_offset = uniform(rng);
+    draw.base = uniform(rng);
     
     if (!config.already_merged) {
         // Apply bunch crossing if enabled
         if (config.use_bunch_crossing) {
-            time_offset = std::floor(time_offset / bunch_crossing_period) * bunch_crossing_period;
+            draw.base = std::floor(draw.base / bunch_crossing_period) * bunch_crossing_period;
         }
         
-        // Apply beam effects if enabled
-        if (config.attach_to_beam) {
-            // Add time offset based on distance along beam
-            time_offset += distance / config.beam_speed;
-            
-            // Add Gaussian spread if specified
-            if (config.beam_spread > 0.0f) {
-                std::normal_distribution<float> spread_dist(0.0f, config.beam_spread);
-                time_offset += spread_dist(rng);
-            }
+        // Gaussian spread if specified
+        if (config.attach_to_beam && config.beam_spread > 0.0f) {
+            std::normal_distribution<float> spread_dist(0.0f, config.beam_spread);
+            draw.spread = spread_dist(rng);
         }
     }
     
-    return time_offset;
+    return draw;
 }
 
-float DataSource::calculateBeamDistance() const {
+float DataSource::applyTimeOffset(const TimeOffsetDraw& draw, float distance) const {
     const auto& config = getConfig();
-    auto vertex = getBeamVertexPosition();
+    float time_offset = draw.base;
+    
+    // Apply beam effects if enabled
+    if (!config.already_merged && config.attach_to_beam) {
+        // Add time offset based on distance along beam
+        time_offset += distance / config.beam_speed;
+        
+        // Add Gaussian spread if specified
+        if (config.beam_spread > 0.0f) {
+            time_offset += draw.spread;
+        }
+    }
     
-    // Distance is dot product of position vector relative to rotation around y of beam relative to z-axis
-    return vertex.z * std::cos(config.beam_angle) + vertex.x * std::sin(config.beam_angle);
+    return time_offset;
+}
+
+void DataSource::UpdateTimeOffset(const TimeOffsetDraw& draw, float distance) {
+    current_time_offset_ = applyTimeOffset(draw, distance);
 }
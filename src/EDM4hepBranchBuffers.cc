@@ -0,0 +1,166 @@
+#include "EDM4hepBranchBuffers.h"
+
+namespace {
+
+template <typename T>
+void bindBranch(TChain& chain, const std::unordered_set<std::string>& available_branches,
+                const std::string& name, T*& buffer) {
+    if (available_branches.count(name)) {
+        chain.SetBranchAddress(name.c_str(), &buffer);
+    }
+}
+
+template <typename T>
+void bindBranches(TChain& chain, const std::unordered_set<std::string>& available_branches,
+                  std::unordered_map<std::string, T*>& buffers) {
+    for (auto& [name, buffer] : buffers) {
+        bindBranch(chain, available_branches, name, buffer);
+    }
+}
+
+template <typename T>
+void copyBuffers(std::unordered_map<std::string, T*>& buffers,
+                 const std::unordered_map<std::string, T*>& other_buffers) {
+    for (auto& [name, buffer] : buffers) {
+        auto it = other_buffers.find(name);
+        if (it != other_buffers.end()) {
+            *buffer = *it->second;
+        } else {
+            buffer->clear();
+        }
+    }
+}
+
+template <typename T>
+void deleteBuffers(std::unordered_map<std::string, T*>& buffers) {
+    for (auto& [name, buffer] : buffers) {
+        delete buffer;
+    }
+}
+
+} // namespace
+
+EDM4hepBranchBuffers::EDM4hepBranchBuffers(const std::vector<std::string>& tracker_collections,
+                                           const std::vector<std::string>& calo_collections,
+                                           const std::vector<std::string>& gp_collections,
+                                           bool read_sub_event_headers) {
+    // MCParticles and parent-child relationships
+    mcparticles = new std::vector<edm4hep::MCParticleData>();
+    objectids["_MCParticles_parents"] = new std::vector<podio::ObjectID>();
+    objectids["_MCParticles_daughters"] = new std::vector<podio::ObjectID>();
+
+    // Tracker hits and their particle references
+    for (const auto& coll_name : tracker_collections) {
+        tracker_hits[coll_name] = new std::vector<edm4hep::SimTrackerHitData>();
+        objectids["_" + coll_name + "_particle"] = new std::vector<podio::ObjectID>();
+    }
+
+    // Calorimeter hits, contributions and their references
+    for (const auto& coll_name : calo_collections) {
+        calo_hits[coll_name] = new std::vector<edm4hep::SimCalorimeterHitData>();
+        objectids["_" + coll_name + "_contributions"] = new std::vector<podio::ObjectID>();
+
+        std::string contrib_branch_name = coll_name + "Contributions";
+        calo_contributions[contrib_branch_name] = new std::vector<edm4hep::CaloHitContributionData>();
+        objectids["_" + contrib_branch_name + "_particle"] = new std::vector<podio::ObjectID>();
+    }
+
+    // Event headers, SubEventHeaders only for already merged sources
+    event_headers["EventHeader"] = new std::vector<edm4hep::EventHeaderData>();
+    if (read_sub_event_headers) {
+        event_headers["SubEventHeaders"] = new std::vector<edm4hep::EventHeaderData>();
+    }
+
+    // GP (Global Parameter) branches
+    gp_int_values = new std::vector<std::vector<int>>();
+    gp_float_values = new std::vector<std::vector<float>>();
+    gp_double_values = new std::vector<std::vector<double>>();
+    gp_string_values = new std::vector<std::vector<std::string>>();
+    for (const auto& branch_name : gp_collections) {
+        gp_keys[branch_name] = new std::vector<std::string>();
+    }
+}
+
+EDM4hepBranchBuffers::~EDM4hepBranchBuffers() {
+    delete mcparticles;
+    deleteBuffers(tracker_hits);
+    deleteBuffers(calo_hits);
+    deleteBuffers(calo_contributions);
+    deleteBuffers(event_headers);
+    deleteBuffers(objectids);
+    deleteBuffers(gp_keys);
+    delete gp_int_values;
+    delete gp_float_values;
+    delete gp_double_values;
+    delete gp_string_values;
+}
+
+std::vector<std::string> EDM4hepBranchBuffers::branchNames(const std::vector<std::string>& tracker_collections,
+                                                           const std::vector<std::string>& calo_collections,
+                                                           const std::vector<std::string>& gp_collections,
+                                                           bool read_sub_event_headers) {
+    std::vector<std::string> names = {"MCParticles", "_MCParticles_parents", "_MCParticles_daughters"};
+    for (const auto& coll_name : tracker_collections) {
+        names.push_back(coll_name);
+        names.push_back("_" + coll_name + "_particle");
+    }
+    for (const auto& coll_name : calo_collections) {
+        std::string contrib_branch_name = coll_name + "Contributions";
+        names.push_back(coll_name);
+        names.push_back("_" + coll_name + "_contributions");
+        names.push_back(contrib_branch_name);
+        names.push_back("_" + contrib_branch_name + "_particle");
+    }
+    names.push_back("EventHeader");
+    if (read_sub_event_headers) {
+        names.push_back("SubEventHeaders");
+    }
+    names.insert(names.end(), {"GPIntValues", "GPFloatValues", "GPDoubleValues", "GPStringValues"});
+    names.insert(names.end(), gp_collections.begin(), gp_collections.end());
+    return names;
+}
+
+void EDM4hepBranchBuffers::bind(TChain& chain, const std::unordered_set<std::string>& available_branches) {
+    bindBranch(chain, available_branches, "MCParticles", mcparticles);
+    bindBranches(chain, available_branches, tracker_hits);
+    bindBranches(chain, available_branches, calo_hits);
+    bindBranches(chain, available_branches, calo_contributions);
+    bindBranches(chain, available_branches, event_headers);
+    bindBranches(chain, available_branches, objectids);
+    bindBranches(chain, available_branches, gp_keys);
+    bindBranch(chain, available_branches, "GPIntValues", gp_int_values);
+    bindBranch(chain, available_branches, "GPFloatValues", gp_float_values);
+    bindBranch(chain, available_branches, "GPDoubleValues", gp_double_values);
+    bindBranch(chain, available_branches, "GPStringValues", gp_string_values);
+}
+
+void EDM4hepBranchBuffers::copyFrom(const EDM4hepBranchBuffers& other) {
+    *mcparticles = *other.mcparticles;
+    copyBuffers(tracker_hits, other.tracker_hits);
+    copyBuffers(calo_hits, other.calo_hits);
+    copyBuffers(calo_contributions, other.calo_contributions);
+    copyBuffers(event_headers, other.event_headers);
+    copyBuffers(objectids, other.objectids);
+    copyBuffers(gp_keys, other.gp_keys);
+    *gp_int_values = *other.gp_int_values;
+    *gp_float_values = *other.gp_float_values;
+    *gp_double_values = *other.gp_double_values;
+    *gp_string_values = *other.gp_string_values;
+}
+
+void EDM4hepBranchBuffers::collectMemoryUsage(MemoryUsage& usage, const std::string& owner_name) const {
+    using memory_accounting::accountVector;
+    const std::string category = "branch_buffer";
+
+    accountVector(usage, owner_name, category, "MCParticles", *mcparticles);
+    for (const auto& [name, vec] : tracker_hits) accountVector(usage, owner_name, category, name, *vec);
+    for (const auto& [name, vec] : calo_hits) accountVector(usage, owner_name, category, name, *vec);
+    for (const auto& [name, vec] : calo_contributions) accountVector(usage, owner_name, category, name, *vec);
+    for (const auto& [name, vec] : event_headers) accountVector(usage, owner_name, category, name, *vec);
+    for (const auto& [name, vec] : objectids) accountVector(usage, owner_name, category, name, *vec);
+    for (const auto& [name, vec] : gp_keys) accountVector(usage, owner_name, category, name, *vec);
+    accountVector(usage, owner_name, category, "GPIntValues", *gp_int_values);
+    accountVector(usage, owner_name, category, "GPFloatValues", *gp_float_values);
+    accountVector(usage, owner_name, category, "GPDoubleValues", *gp_double_values);
+    accountVector(usage, owner_name, category, "GPStringValues", *gp_string_values);
+}
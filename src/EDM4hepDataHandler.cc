@@ -1,50 +1,290 @@
 #include "EDM4hepDataHandler.h"
+#include "TimeframeConcat.h"
+#include "SubEventTimeOffsets.h"
 #include <iostream>
 #include <algorithm>
+#include <functional>
+#include <limits>
 #include <stdexcept>
+#include <thread>
 #include <TBranch.h>
 #include <TObjArray.h>
 #include <TChain.h>
+#include <TROOT.h>
 
-void EDM4hepMergedCollections::clear() {
-    // Use clear() but preserve capacity to avoid repeated memory allocations
-    mcparticles.clear();
-    event_headers.clear();
-    event_header_weights.clear();
-    sub_event_headers.clear();
-    sub_event_header_weights.clear();
+namespace {
+
+// Move the elements of a source buffer to the end of a merged vector. The first contributor
+// to an empty merged vector swaps with it instead, leaving the emptied vector to the source
+// to decode its next entry into, so nothing is copied. Only a merged vector with no more
+// capacity than the buffer is swapped: a frame-sized merged vector would otherwise go to
+// the source and be regrown from event size. Both vector objects stay in place, keeping
+// output branches and input branch addresses bound
+template <typename T>
+void appendOrSwap(std::vector<T>& target, std::vector<T>& buffer) {
+    if (target.empty() && target.capacity() <= buffer.capacity()) {
+        target.swap(buffer);
+        return;
+    }
+    target.insert(target.end(), std::make_move_iterator(buffer.begin()), std::make_move_iterator(buffer.end()));
+}
+
+// Set kept_before[i] to the number of elements before i with a time in [t_min, t_max], so
+// kept_before[i] is the new index of a kept element i and kept_before[n] the count kept.
+// With begins, the times are lazy and get the offset of their sub-event range added
+template <typename T>
+size_t indexInWindow(const std::vector<T>& elements, float t_min, float t_max,
+                     const std::vector<float>& offsets, const std::vector<uint32_t>* begins,
+                     std::vector<uint32_t>& kept_before) {
+    kept_before.resize(elements.size() + 1);
+    uint32_t kept = 0;
+    size_t sub_event = 0;
+    float offset = 0.0f;
+    for (size_t i = 0; i < elements.size(); ++i) {
+        while (begins && sub_event < begins->size() && (*begins)[sub_event] <= i) {
+            offset = offsets[sub_event++];
+        }
+        kept_before[i] = kept;
+        const float time = elements[i].time + offset;
+        if (time >= t_min && time <= t_max) {
+            ++kept;
+        }
+    }
+    kept_before[elements.size()] = kept;
+    return kept;
+}
+
+// Keep the elements indexInWindow kept, in order; elements is parallel to the indexed collection
+template <typename T>
+void compactInWindow(std::vector<T>& elements, const std::vector<uint32_t>& kept_before) {
+    const size_t n = std::min(elements.size(), kept_before.size() - 1);
+    for (size_t i = 0; i < n; ++i) {
+        if (kept_before[i + 1] > kept_before[i]) {
+            elements[kept_before[i]] = elements[i];
+        }
+    }
+    elements.resize(kept_before[n]);
+}
+
+// Collections with at least this many elements (contributions for calorimeters) are sorted
+// with their passes split over the sort pool instead of by a single task
+constexpr size_t kParallelSortMinElements = 1 << 16;
+
+// Run range(begin, end) over [0, n), split into one block per pool thread when a pool is given
+template <typename Range>
+void forEachBlock(ThreadPool* pool, size_t n, Range&& range) {
+    if (!pool) {
+        range(size_t{0}, n);
+        return;
+    }
+    const size_t n_blocks = pool->size();
+    pool->parallelFor(n_blocks, [&](size_t b) {
+        const auto block = radix_sort::blockRange(n, n_blocks, b);
+        range(block.first, block.second);
+    });
+}
+
+template <typename T, typename Key>
+const std::vector<uint32_t>& timeOrder(const std::vector<T>& elements, Key&& key, radix_sort::Scratch& scratch,
+                                       ThreadPool* pool) {
+    if (!pool) {
+        return radix_sort::sortedOrder(elements, key, scratch);
+    }
+    return radix_sort::sortedOrderParallel(elements, key, scratch, pool->size(),
+        [pool](size_t n, const std::function<void(size_t)>& task) { pool->parallelFor(n, task); });
+}
+
+template <typename T>
+void applyTimeOrder(std::vector<T>& elements, const std::vector<uint32_t>& order, std::vector<uint32_t>& visited,
+                    std::vector<T>& buffer, ThreadPool* pool) {
+    if (!pool) {
+        radix_sort::applyOrder(elements, order, visited);
+        return;
+    }
+    radix_sort::applyOrderParallel(elements, order, buffer, pool->size(),
+        [pool](size_t n, const std::function<void(size_t)>& task) { pool->parallelFor(n, task); });
+}
+
+}  // namespace
+
+template <typename ClearFn>
+void EDM4hepMergedCollections::clearVectors(ClearFn&& clear_vector) {
+    clear_vector(mcparticles);
+    clear_vector(event_headers);
+    clear_vector(event_header_weights);
+    clear_vector(sub_event_headers);
+    clear_vector(sub_event_header_weights);
     
     for (auto& [name, vec] : tracker_hits) {
-        vec.clear();
+        clear_vector(vec);
     }
     for (auto& [name, vec] : calo_hits) {
-        vec.clear();
+        clear_vector(vec);
     }
     for (auto& [name, vec] : calo_contributions) {
-        vec.clear();
+        clear_vector(vec);
     }
     for (auto& [name, vec] : tracker_hit_particle_refs) {
-        vec.clear();
+        clear_vector(vec);
     }
     for (auto& [name, vec] : calo_contrib_particle_refs) {
-        vec.clear();
+        clear_vector(vec);
     }
     
-    mcparticle_parents_refs.clear();
-    mcparticle_daughters_refs.clear();
+    clear_vector(mcparticle_parents_refs);
+    clear_vector(mcparticle_daughters_refs);
     
     for (auto& [name, vec] : calo_hit_contributions_refs) {
-        vec.clear();
+        clear_vector(vec);
     }
     
     // Clear GP branches
     for (auto& [name, vec] : gp_key_branches) {
-        vec.clear();
+        clear_vector(vec);
+    }
+    clear_vector(gp_int_values);
+    clear_vector(gp_float_values);
+    clear_vector(gp_double_values);
+    clear_vector(gp_string_values);
+    clear_vector(sub_event_time_offsets);
+    for (auto& [name, vec] : sub_event_begins) {
+        clear_vector(vec);
+    }
+}
+
+void EDM4hepMergedCollections::clear() {
+    // Use clear() but preserve capacity to avoid repeated memory allocations
+    clearVectors([](auto& vec) { vec.clear(); });
+}
+
+void EDM4hepMergedCollections::clear(CapacityManager& capacity_manager) {
+    // Keep capacity near recent sizes instead of the largest timeframe seen
+    clearVectors([&capacity_manager](auto& vec) { capacity_manager.clear(vec); });
+    capacity_manager.enforceMemoryCap();
+}
+
+void EDM4hepMergedCollections::copyFrom(const EDM4hepMergedCollections& other) {
+    // Assigning each vector reuses its capacity; map entries are created only on the first copy
+    auto copyMap = [](auto& target, const auto& source) {
+        for (const auto& [name, vec] : source) {
+            target[name] = vec;
+        }
+    };
+    mcparticles = other.mcparticles;
+    event_headers = other.event_headers;
+    event_header_weights = other.event_header_weights;
+    sub_event_headers = other.sub_event_headers;
+    sub_event_header_weights = other.sub_event_header_weights;
+    copyMap(tracker_hits, other.tracker_hits);
+    copyMap(calo_hits, other.calo_hits);
+    copyMap(calo_contributions, other.calo_contributions);
+    mcparticle_parents_refs = other.mcparticle_parents_refs;
+    mcparticle_daughters_refs = other.mcparticle_daughters_refs;
+    copyMap(tracker_hit_particle_refs, other.tracker_hit_particle_refs);
+    copyMap(calo_contrib_particle_refs, other.calo_contrib_particle_refs);
+    copyMap(calo_hit_contributions_refs, other.calo_hit_contributions_refs);
+    copyMap(gp_key_branches, other.gp_key_branches);
+    gp_int_values = other.gp_int_values;
+    gp_float_values = other.gp_float_values;
+    gp_double_values = other.gp_double_values;
+    gp_string_values = other.gp_string_values;
+    sub_event_time_offsets = other.sub_event_time_offsets;
+    copyMap(sub_event_begins, other.sub_event_begins);
+}
+
+void EDM4hepMergedCollections::collectMemoryUsage(MemoryUsage& usage, const std::string& owner) const {
+    using memory_accounting::accountVector;
+
+    accountVector(usage, owner, "collection", "MCParticles", mcparticles);
+    accountVector(usage, owner, "collection", "EventHeader", event_headers);
+    accountVector(usage, owner, "collection", "_EventHeader_weights", event_header_weights);
+    accountVector(usage, owner, "collection", "SubEventHeaders", sub_event_headers);
+    accountVector(usage, owner, "collection", "_SubEventHeader_weights", sub_event_header_weights);
+
+    for (const auto& [name, vec] : tracker_hits) {
+        accountVector(usage, owner, "collection", name, vec);
+    }
+    for (const auto& [name, vec] : calo_hits) {
+        accountVector(usage, owner, "collection", name, vec);
+    }
+    for (const auto& [name, vec] : calo_contributions) {
+        accountVector(usage, owner, "collection", name, vec);
+    }
+
+    accountVector(usage, owner, "reference", "_MCParticles_parents", mcparticle_parents_refs);
+    accountVector(usage, owner, "reference", "_MCParticles_daughters", mcparticle_daughters_refs);
+    for (const auto& [name, vec] : tracker_hit_particle_refs) {
+        accountVector(usage, owner, "reference", name, vec);
+    }
+    for (const auto& [name, vec] : calo_contrib_particle_refs) {
+        accountVector(usage, owner, "reference", name, vec);
+    }
+    for (const auto& [name, vec] : calo_hit_contributions_refs) {
+        accountVector(usage, owner, "reference", name, vec);
+    }
+
+    for (const auto& [name, vec] : gp_key_branches) {
+        accountVector(usage, owner, "gp", name, vec);
+    }
+    accountVector(usage, owner, "gp", "GPIntValues", gp_int_values);
+    accountVector(usage, owner, "gp", "GPFloatValues", gp_float_values);
+    accountVector(usage, owner, "gp", "GPDoubleValues", gp_double_values);
+    accountVector(usage, owner, "gp", "GPStringValues", gp_string_values);
+
+    accountVector(usage, owner, "offsets", SubEventTimeOffsets::offsetsBranch(), sub_event_time_offsets);
+    for (const auto& [name, vec] : sub_event_begins) {
+        accountVector(usage, owner, "offsets", SubEventTimeOffsets::beginBranch(name), vec);
+    }
+}
+
+void EDM4hepMergedCollections::setupBranches(TTree* tree,
+                                             const std::vector<std::string>& tracker_collection_names,
+                                             const std::vector<std::string>& calo_collection_names,
+                                             const std::vector<std::string>& gp_collection_names) {
+    // Create all required branches
+    tree->Branch("EventHeader", &event_headers);
+    tree->Branch("_EventHeader_weights", &event_header_weights);
+    tree->Branch("SubEventHeaders", &sub_event_headers);
+    tree->Branch("_SubEventHeader_weights", &sub_event_header_weights);
+    tree->Branch("MCParticles", &mcparticles);
+    tree->Branch("_MCParticles_daughters", &mcparticle_daughters_refs);
+    tree->Branch("_MCParticles_parents", &mcparticle_parents_refs);
+
+    // Tracker collections and their references
+    for (const auto& name : tracker_collection_names) {
+        tree->Branch(name.c_str(), &tracker_hits[name]);        
+        std::string ref_name = "_" + name + "_particle";
+        tree->Branch(ref_name.c_str(), &tracker_hit_particle_refs[name]);
+    }
+
+    // Calorimeter collections and their references
+    for (const auto& name : calo_collection_names) {
+        tree->Branch(name.c_str(), &calo_hits[name]);        
+        std::string ref_name = "_" + name + "_contributions";
+        tree->Branch(ref_name.c_str(), &calo_hit_contributions_refs[name]);        
+        std::string contrib_name = name + "Contributions";
+        tree->Branch(contrib_name.c_str(), &calo_contributions[name]);        
+        std::string ref_name_contrib = "_" + contrib_name + "_particle";
+        tree->Branch(ref_name_contrib.c_str(), &calo_contrib_particle_refs[name]);
+    }
+    
+    // GP (Global Parameter) branches
+    for (const auto& name : gp_collection_names) {
+        tree->Branch(name.c_str(), &gp_key_branches[name]);
+    }
+    
+    tree->Branch("GPIntValues", &gp_int_values);    
+    tree->Branch("GPFloatValues", &gp_float_values);    
+    tree->Branch("GPDoubleValues", &gp_double_values);    
+    tree->Branch("GPStringValues", &gp_string_values);
+}
+
+void EDM4hepMergedCollections::setupSubEventOffsetBranches(TTree* tree,
+                                                           const std::vector<std::string>& time_collection_names) {
+    tree->Branch(SubEventTimeOffsets::offsetsBranch().c_str(), &sub_event_time_offsets);
+    for (const auto& name : time_collection_names) {
+        tree->Branch(SubEventTimeOffsets::beginBranch(name).c_str(), &sub_event_begins[name]);
     }
-    gp_int_values.clear();
-    gp_float_values.clear();
-    gp_double_values.clear();
-    gp_string_values.clear();
 }
 
 std::vector<std::unique_ptr<DataSource>> EDM4hepDataHandler::initializeDataSources(
@@ -86,11 +326,53 @@ std::vector<std::unique_ptr<DataSource>> EDM4hepDataHandler::initializeDataSourc
         data_sources.push_back(std::move(data_source));
     }
     
+    // Sources gathered in parallel read and decode concurrently, so they can share neither
+    // decode buffers nor readers
+    const bool parallel_sources = config_ &&
+        ((config_->parallel_sources && source_configs.size() > 1) || config_->chunk_entries > 0);
+    if (parallel_sources) {
+        ROOT::EnableThreadSafety();
+        if (config_->share_source_buffers || config_->share_input_readers) {
+            std::cout << "Parallel source gathering: decode buffer and input reader sharing disabled" << std::endl;
+        }
+    }
+
+    // Sources are merged one after another, so sources with the same schema can share decode buffers
+    if (config_ && config_->share_source_buffers && !parallel_sources) {
+        buffer_pool_ = std::make_unique<EDM4hepBufferPool>();
+    }
+
     // Store pointers to EDM4hep sources for later use
+    lazy_time_offsets_ = config_ && config_->lazy_time_offsets;
     edm4hep_sources_.clear();
     edm4hep_sources_.reserve(data_sources.size());
     for (auto& source : data_sources) {
-        edm4hep_sources_.push_back(dynamic_cast<EDM4hepDataSource*>(source.get()));
+        auto* edm4hep_source = dynamic_cast<EDM4hepDataSource*>(source.get());
+        edm4hep_source->setBufferPool(buffer_pool_.get());
+        edm4hep_source->setLazyTimeOffsets(lazy_time_offsets_);
+        edm4hep_sources_.push_back(edm4hep_source);
+    }
+
+    // Sources reading the same files share one chain, TTreeCache and decode cache
+    input_readers_.clear();
+    if (config_ && config_->share_input_readers && !parallel_sources) {
+        for (auto* edm4hep_source : edm4hep_sources_) {
+            const auto& source_config = edm4hep_source->getConfig();
+            auto key = EDM4hepInputReader::key(source_config.tree_name, source_config.input_files,
+                                               source_config.already_merged);
+            auto& reader = input_readers_[key];
+            if (!reader) {
+                reader = std::make_shared<EDM4hepInputReader>(source_config.tree_name, source_config.input_files);
+            }
+            reader->addUser();
+            edm4hep_source->setInputReader(reader);
+        }
+        for (auto& [key, reader] : input_readers_) {
+            if (reader->getUsers() > 1) {
+                reader->setCacheEntries(config_->decode_cache_entries);
+            }
+        }
+        std::cout << data_sources.size() << " sources share " << input_readers_.size() << " input readers" << std::endl;
     }
     
     // Open output file
@@ -100,19 +382,41 @@ std::vector<std::unique_ptr<DataSource>> EDM4hepDataHandler::initializeDataSourc
     }
     
     // Set ROOT I/O optimizations
-    output_file_->SetCompressionLevel(1);
+    output_file_->SetCompressionSettings(getCompressionSettings());
+
+    // Adaptive capacity of the merged collections
+    if (config_ && (config_->capacity_policy || config_->memory_cap_mb > 0.0f)) {
+        CapacityPolicy policy;
+        policy.window = config_->capacity_window;
+        policy.quantile = config_->capacity_quantile;
+        policy.headroom = config_->capacity_headroom;
+        policy.shrink_after = config_->capacity_shrink_after;
+        policy.memory_cap_bytes = static_cast<size_t>(config_->memory_cap_mb * 1024.0 * 1024.0);
+        capacity_manager_ = std::make_unique<CapacityManager>(policy);
+    }
     
     // Create output tree
     output_tree_ = new TTree("events", "Merged timeframes");
     
     // Discover collections from sources
     discoverCollections(data_sources);
+    setupTimeWindows();
+    if (config_ && config_->sort_by_time) {
+        setupTimeSort();
+    }
     
     // Setup output tree branches
     setupOutputTree();
     
     // Copy metadata from first source
     copyPodioMetadata(data_sources);
+
+    // Split the read cache budget across the (now open) input chains
+    setupIOBudget();
+
+    if (buffer_pool_) {
+        std::cout << data_sources.size() << " sources share " << buffer_pool_->size() << " sets of decode buffers" << std::endl;
+    }
     
     std::cout << "EDM4hep data handler initialized successfully" << std::endl;
     
@@ -120,133 +424,336 @@ std::vector<std::unique_ptr<DataSource>> EDM4hepDataHandler::initializeDataSourc
 }
 
 void EDM4hepDataHandler::prepareTimeframe() {
-    collections_.clear();
+    if (capacity_manager_) {
+        collections_.clear(*capacity_manager_);
+    } else {
+        collections_.clear();
+    }
+    timeframe_events_ = 0;
 }
 
-void EDM4hepDataHandler::processEvent(DataSource& source) {
-    auto* edm4hep_source = dynamic_cast<EDM4hepDataSource*>(&source);
-    if (!edm4hep_source) {
-        throw std::runtime_error("EDM4hepDataHandler: Expected EDM4hepDataSource");
+void EDM4hepDataHandler::saveBackground() {
+    background_.copyFrom(collections_);
+    background_events_ = timeframe_events_;
+}
+
+void EDM4hepDataHandler::restoreBackground() {
+    collections_.copyFrom(background_);
+    timeframe_events_ = background_events_;
+}
+
+void EDM4hepDataHandler::processEvent(EDM4hepDataSource& source) {
+    appendEvent(source, collections_, events_consumed_, timeframe_events_ == 0);
+    events_consumed_++;
+    timeframe_events_++;
+}
+
+void EDM4hepDataHandler::appendEvent(EDM4hepDataSource& source, EDM4hepMergedCollections& collections,
+                                     int events_consumed, bool first_contributor) {
+    const auto& config = source.getConfig();
+
+    // Times of pre-merged inputs are shifted already
+    if (lazy_time_offsets_) {
+        recordSubEvent(collections, config.already_merged ? 0.0f : source.getCurrentTimeOffset());
     }
-    
-    static int totalEventsConsumed = 0;  // Track across all sources
-    
+
+    // A pre-merged timeframe contributing first needs no offsets, take over its buffers
+    if (first_contributor && config.already_merged) {
+        swapInMergedTimeframe(source, collections);
+        return;
+    }
+
     // Calculate particle index offset for this event
-    size_t particle_index_offset   = collections_.mcparticles.size();
-    size_t particle_parents_offset = collections_.mcparticle_parents_refs.size();
-    size_t particle_daughters_offset = collections_.mcparticle_daughters_refs.size();
+    size_t particle_index_offset   = collections.mcparticles.size();
+    size_t particle_parents_offset = collections.mcparticle_parents_refs.size();
+    size_t particle_daughters_offset = collections.mcparticle_daughters_refs.size();
     
-    // Process MCParticles - use move semantics to avoid copying
-    auto& processed_particles = edm4hep_source->processMCParticles(particle_parents_offset, particle_daughters_offset, totalEventsConsumed);
-    collections_.mcparticles.insert(collections_.mcparticles.end(), 
-                                          std::make_move_iterator(processed_particles.begin()), 
-                                          std::make_move_iterator(processed_particles.end()));
+    // Process MCParticles - appended, or swapped in when the collection is still empty
+    auto& processed_particles = source.processMCParticles(particle_parents_offset, particle_daughters_offset, events_consumed);
+    appendOrSwap(collections.mcparticles, processed_particles);
     
     // Process MCParticle references - use move semantics
     std::string parent_ref_branch_name = "_MCParticles_parents";
-    auto& processed_parents = edm4hep_source->processObjectID(parent_ref_branch_name, particle_index_offset,totalEventsConsumed);
-    collections_.mcparticle_parents_refs.insert(collections_.mcparticle_parents_refs.end(),
-                                                      std::make_move_iterator(processed_parents.begin()), 
-                                                      std::make_move_iterator(processed_parents.end()));
+    auto& processed_parents = source.processObjectID(parent_ref_branch_name, particle_index_offset,events_consumed);
+    appendOrSwap(collections.mcparticle_parents_refs, processed_parents);
 
     std::string daughters_ref_branch_name = "_MCParticles_daughters";
-    auto& processed_daughters = edm4hep_source->processObjectID(daughters_ref_branch_name, particle_index_offset,totalEventsConsumed);
-    collections_.mcparticle_daughters_refs.insert(collections_.mcparticle_daughters_refs.end(),
-                                                       std::make_move_iterator(processed_daughters.begin()), 
-                                                       std::make_move_iterator(processed_daughters.end()));
+    auto& processed_daughters = source.processObjectID(daughters_ref_branch_name, particle_index_offset,events_consumed);
+    appendOrSwap(collections.mcparticle_daughters_refs, processed_daughters);
 
-    const auto& config = edm4hep_source->getConfig();
-    
     // Process SubEventHeaders for non-merged sources to track which MCParticles came from this source
     if (!config.already_merged) {
         // Create a SubEventHeader for this source/event combination
         edm4hep::EventHeaderData sub_header;
-        sub_header.eventNumber = totalEventsConsumed;
-        sub_header.runNumber = edm4hep_source->getSourceIndex();
+        sub_header.eventNumber = events_consumed;
+        sub_header.runNumber = source.getSourceIndex();
         sub_header.timeStamp = particle_index_offset;
-        sub_header.weight = edm4hep_source->getCurrentTimeOffset();
+        sub_header.weight = source.getCurrentTimeOffset();
 
-        collections_.sub_event_headers.push_back(sub_header);
-        collections_.sub_event_header_weights.push_back(sub_header.weight);
+        collections.sub_event_headers.push_back(sub_header);
+        collections.sub_event_header_weights.push_back(sub_header.weight);
     } else {
-        // For already merged sources, process existing SubEventHeaders if available
-        auto& existing_sub_headers = edm4hep_source->processEventHeaders("SubEventHeaders");
+        // For already merged sources, carry over the existing SubEventHeaders; timeStamp holds
+        // the index of the sub-event's first particle, weight its time offset
+        auto& existing_sub_headers = source.processEventHeaders("SubEventHeaders");
         for (auto& sub_header : existing_sub_headers) {
-            float original_offset = sub_header.weight;
-            sub_header.weight += static_cast<float>(particle_index_offset);
-            collections_.sub_event_headers.push_back(sub_header);
-            collections_.sub_event_header_weights.push_back(sub_header.weight);
+            sub_header.timeStamp += particle_index_offset;
+            collections.sub_event_headers.push_back(sub_header);
+            collections.sub_event_header_weights.push_back(sub_header.weight);
         }
     }
     
-    // Process tracker hits
+    // Process tracker hits; collections the event has no hits in are left untouched
     for (const auto& name : tracker_collection_names_) {
-        auto& processed_hits = edm4hep_source->processTrackerHits(name, particle_index_offset,totalEventsConsumed);
-        collections_.tracker_hits[name].insert(collections_.tracker_hits[name].end(),
-                                                     std::make_move_iterator(processed_hits.begin()), 
-                                                     std::make_move_iterator(processed_hits.end()));
+        auto& processed_hits = source.processTrackerHits(name, particle_index_offset,events_consumed);
+        if (processed_hits.empty()) continue;
+        appendOrSwap(collections.tracker_hits[name], processed_hits);
 
         std::string ref_branch_name = "_" + name + "_particle";
-        auto& processed_refs = edm4hep_source->processObjectID(ref_branch_name, particle_index_offset,totalEventsConsumed);
-        collections_.tracker_hit_particle_refs[name].insert(collections_.tracker_hit_particle_refs[name].end(),
-                                                                  std::make_move_iterator(processed_refs.begin()), 
-                                                                  std::make_move_iterator(processed_refs.end()));
+        auto& processed_refs = source.processObjectID(ref_branch_name, particle_index_offset,events_consumed);
+        appendOrSwap(collections.tracker_hit_particle_refs[name], processed_refs);
     }
     
     // Process calorimeter hits
     for (const auto& name : calo_collection_names_) {
-        size_t existing_contrib_size = collections_.calo_contributions[name].size();
+        size_t existing_contrib_size = collections.calo_contributions[name].size();
 
-        auto& processed_hits = edm4hep_source->processCaloHits(name, existing_contrib_size,totalEventsConsumed);
-        collections_.calo_hits[name].insert(collections_.calo_hits[name].end(),
-                                                  std::make_move_iterator(processed_hits.begin()), 
-                                                  std::make_move_iterator(processed_hits.end()));
+        auto& processed_hits = source.processCaloHits(name, existing_contrib_size,events_consumed);
+        if (processed_hits.empty()) continue;
+        appendOrSwap(collections.calo_hits[name], processed_hits);
         
         std::string ref_branch_name = "_" + name + "_contributions";
-        auto& processed_contrib_refs = edm4hep_source->processObjectID(ref_branch_name, existing_contrib_size,totalEventsConsumed);
-        collections_.calo_hit_contributions_refs[name].insert(collections_.calo_hit_contributions_refs[name].end(),
-                                                                    std::make_move_iterator(processed_contrib_refs.begin()), 
-                                                                    std::make_move_iterator(processed_contrib_refs.end()));
+        auto& processed_contrib_refs = source.processObjectID(ref_branch_name, existing_contrib_size,events_consumed);
+        appendOrSwap(collections.calo_hit_contributions_refs[name], processed_contrib_refs);
         
         // Process contributions
         std::string contrib_branch_name = name + "Contributions";
-        auto& processed_contribs = edm4hep_source->processCaloContributions(contrib_branch_name, particle_index_offset,totalEventsConsumed);
-        collections_.calo_contributions[name].insert(collections_.calo_contributions[name].end(),
-                                                           std::make_move_iterator(processed_contribs.begin()), 
-                                                           std::make_move_iterator(processed_contribs.end()));
+        auto& processed_contribs = source.processCaloContributions(contrib_branch_name, particle_index_offset,events_consumed);
+        appendOrSwap(collections.calo_contributions[name], processed_contribs);
         
         std::string ref_branch_name_contrib = "_" + contrib_branch_name + "_particle";
-        auto& processed_contrib_particle_refs = edm4hep_source->processObjectID(ref_branch_name_contrib, particle_index_offset,totalEventsConsumed);
-        collections_.calo_contrib_particle_refs[name].insert(collections_.calo_contrib_particle_refs[name].end(),
-                                                                   std::make_move_iterator(processed_contrib_particle_refs.begin()), 
-                                                                   std::make_move_iterator(processed_contrib_particle_refs.end()));
+        auto& processed_contrib_particle_refs = source.processObjectID(ref_branch_name_contrib, particle_index_offset,events_consumed);
+        appendOrSwap(collections.calo_contrib_particle_refs[name], processed_contrib_particle_refs);
     }
     
     // Process GP (Global Parameter) branches
     for (const auto& name : gp_collection_names_) {
-        auto& gp_keys = edm4hep_source->processGPBranch(name);
-        collections_.gp_key_branches[name].insert(collections_.gp_key_branches[name].end(),
-                                                            std::make_move_iterator(gp_keys.begin()), std::make_move_iterator(gp_keys.end()));
+        auto& gp_keys = source.processGPBranch(name);
+        appendOrSwap(collections.gp_key_branches[name], gp_keys);
     }
 
     // Process GP value branches
-    auto& gp_int_values = edm4hep_source->processGPIntValues();
-    collections_.gp_int_values.insert(collections_.gp_int_values.end(),
-        std::make_move_iterator(gp_int_values.begin()), std::make_move_iterator(gp_int_values.end()));
+    auto& gp_int_values = source.processGPIntValues();
+    appendOrSwap(collections.gp_int_values, gp_int_values);
 
-    auto& gp_float_values = edm4hep_source->processGPFloatValues();
-    collections_.gp_float_values.insert(collections_.gp_float_values.end(),
-        std::make_move_iterator(gp_float_values.begin()), std::make_move_iterator(gp_float_values.end()));
+    auto& gp_float_values = source.processGPFloatValues();
+    appendOrSwap(collections.gp_float_values, gp_float_values);
 
-    auto& gp_double_values = edm4hep_source->processGPDoubleValues();
-    collections_.gp_double_values.insert(collections_.gp_double_values.end(),
-        std::make_move_iterator(gp_double_values.begin()), std::make_move_iterator(gp_double_values.end()));
+    auto& gp_double_values = source.processGPDoubleValues();
+    appendOrSwap(collections.gp_double_values, gp_double_values);
 
-    auto& gp_string_values = edm4hep_source->processGPStringValues();
-    collections_.gp_string_values.insert(collections_.gp_string_values.end(),
-        std::make_move_iterator(gp_string_values.begin()), std::make_move_iterator(gp_string_values.end()));
-    
-    totalEventsConsumed++;
+    auto& gp_string_values = source.processGPStringValues();
+    appendOrSwap(collections.gp_string_values, gp_string_values);
+}
+
+void EDM4hepDataHandler::recordSubEvent(EDM4hepMergedCollections& collections, float time_offset) {
+    collections.sub_event_time_offsets.push_back(time_offset);
+    collections.sub_event_begins["MCParticles"].push_back(collections.mcparticles.size());
+    for (const auto& name : tracker_collection_names_) {
+        collections.sub_event_begins[name].push_back(collections.tracker_hits[name].size());
+    }
+    for (const auto& name : calo_collection_names_) {
+        collections.sub_event_begins[name + "Contributions"].push_back(collections.calo_contributions[name].size());
+    }
+}
+
+void EDM4hepDataHandler::swapInMergedTimeframe(EDM4hepDataSource& source, EDM4hepMergedCollections& collections) {
+    // Swapping keeps both vector objects in place, so the output branches and the input
+    // branch addresses stay bound; the source decodes its next entry into the emptied
+    // vectors the collections held. The process* calls return the buffers untouched
+    // for a first contributor (events_consumed 0)
+    collections.mcparticles.swap(source.processMCParticles(0, 0, 0));
+    collections.mcparticle_parents_refs.swap(source.processObjectID("_MCParticles_parents", 0, 0));
+    collections.mcparticle_daughters_refs.swap(source.processObjectID("_MCParticles_daughters", 0, 0));
+
+    collections.sub_event_headers.swap(source.processEventHeaders("SubEventHeaders"));
+    for (const auto& sub_header : collections.sub_event_headers) {
+        collections.sub_event_header_weights.push_back(sub_header.weight);
+    }
+
+    for (const auto& name : tracker_collection_names_) {
+        collections.tracker_hits[name].swap(source.processTrackerHits(name, 0, 0));
+        collections.tracker_hit_particle_refs[name].swap(source.processObjectID("_" + name + "_particle", 0, 0));
+    }
+
+    for (const auto& name : calo_collection_names_) {
+        const std::string contrib_branch_name = name + "Contributions";
+        collections.calo_hits[name].swap(source.processCaloHits(name, 0, 0));
+        collections.calo_hit_contributions_refs[name].swap(source.processObjectID("_" + name + "_contributions", 0, 0));
+        collections.calo_contributions[name].swap(source.processCaloContributions(contrib_branch_name, 0, 0));
+        collections.calo_contrib_particle_refs[name].swap(
+            source.processObjectID("_" + contrib_branch_name + "_particle", 0, 0));
+    }
+
+    for (const auto& name : gp_collection_names_) {
+        collections.gp_key_branches[name].swap(source.processGPBranch(name));
+    }
+    collections.gp_int_values.swap(source.processGPIntValues());
+    collections.gp_float_values.swap(source.processGPFloatValues());
+    collections.gp_double_values.swap(source.processGPDoubleValues());
+    collections.gp_string_values.swap(source.processGPStringValues());
+}
+
+void EDM4hepDataHandler::prepareStaging(const std::vector<std::unique_ptr<DataSource>>& sources,
+                                        const std::vector<GatherChunk>& chunks) {
+    staging_.resize(chunks.size());
+    for (size_t slot = 0; slot < chunks.size(); ++slot) {
+        const auto& source = *sources[chunks[slot].source];
+        auto& staging = staging_[slot];
+        staging.collections.clear();
+        staging.events = 0;
+        staging.name = source.getName();
+        staging.already_merged = source.getConfig().already_merged;
+    }
+}
+
+void EDM4hepDataHandler::gatherChunk(size_t slot,
+                                     const GatherChunk& chunk,
+                                     DataSource& source,
+                                     std::span<const DataSource::TimeOffsetDraw> draws) {
+    // The first chunk of a source reads through the source itself, the others through
+    // private readers; offsets inside the slot start at zero and are shifted in concatenateStaging
+    auto& edm4hep_source = static_cast<EDM4hepDataSource&>(source);
+    std::unique_ptr<EDM4hepDataSource> chunk_reader;
+    if (chunk.first_draw > 0) {
+        chunk_reader = acquireChunkReader(edm4hep_source);
+    }
+    auto& staging = staging_[slot];
+    runChunk(chunk_reader ? *chunk_reader : edm4hep_source, chunk.first_entry, draws,
+             [this, &staging](EDM4hepDataSource& reader) {
+                 appendEvent(reader, staging.collections, staging.events, staging.events == 0);
+                 staging.events++;
+             });
+    if (chunk_reader) {
+        std::lock_guard<std::mutex> lock(chunk_readers_mutex_);
+        chunk_readers_[source.getSourceIndex()].push_back(std::move(chunk_reader));
+    }
+}
+
+std::unique_ptr<EDM4hepDataSource> EDM4hepDataHandler::acquireChunkReader(const EDM4hepDataSource& source) {
+    {
+        std::lock_guard<std::mutex> lock(chunk_readers_mutex_);
+        auto& idle = chunk_readers_[source.getSourceIndex()];
+        if (!idle.empty()) {
+            auto reader = std::move(idle.back());
+            idle.pop_back();
+            return reader;
+        }
+    }
+
+    // One more reader of the source's files with its own chain and decode buffers
+    auto reader = std::make_unique<EDM4hepDataSource>(source.getConfig(), source.getSourceIndex());
+    reader->setLazyTimeOffsets(lazy_time_offsets_);
+    reader->initialize(tracker_collection_names_, calo_collection_names_, gp_collection_names_);
+
+    // The reader takes part of the source's cache budget instead of ROOT's default cache
+    if (io_budget_) {
+        io_budget_->addReaderChain(source.getInputReader()->getChain(), reader->getInputReader()->getChain());
+    }
+    return reader;
+}
+
+void EDM4hepDataHandler::concatenateStaging() {
+    // The first staging slot lands in empty collections and is swapped in
+    auto append = [](auto& target, auto& staged) { appendOrSwap(target, staged); };
+    auto shiftRefs = [](std::vector<podio::ObjectID>& refs, size_t offset) {
+        for (auto& ref : refs) {
+            ref.index += offset;
+        }
+    };
+
+    // Apply the offsets appendEvent would have applied had the sources been merged in sequence
+    for (auto& staging : staging_) {
+        auto& staged = staging.collections;
+        const size_t particle_offset = collections_.mcparticles.size();
+        const size_t parents_offset = collections_.mcparticle_parents_refs.size();
+        const size_t daughters_offset = collections_.mcparticle_daughters_refs.size();
+
+        // Sub-event ranges start at the end of the collections before this slot is appended
+        if (lazy_time_offsets_) {
+            auto shiftBegins = [&](const std::string& name, size_t offset) {
+                auto& begins = staged.sub_event_begins[name];
+                for (auto& begin : begins) {
+                    begin += offset;
+                }
+                append(collections_.sub_event_begins[name], begins);
+            };
+            shiftBegins("MCParticles", particle_offset);
+            for (const auto& name : tracker_collection_names_) {
+                shiftBegins(name, collections_.tracker_hits[name].size());
+            }
+            for (const auto& name : calo_collection_names_) {
+                shiftBegins(name + "Contributions", collections_.calo_contributions[name].size());
+            }
+            append(collections_.sub_event_time_offsets, staged.sub_event_time_offsets);
+        }
+
+        for (auto& particle : staged.mcparticles) {
+            particle.parents_begin   += parents_offset;
+            particle.parents_end     += parents_offset;
+            particle.daughters_begin += daughters_offset;
+            particle.daughters_end   += daughters_offset;
+        }
+        append(collections_.mcparticles, staged.mcparticles);
+        shiftRefs(staged.mcparticle_parents_refs, particle_offset);
+        append(collections_.mcparticle_parents_refs, staged.mcparticle_parents_refs);
+        shiftRefs(staged.mcparticle_daughters_refs, particle_offset);
+        append(collections_.mcparticle_daughters_refs, staged.mcparticle_daughters_refs);
+
+        if (!staging.already_merged) {
+            for (auto& sub_header : staged.sub_event_headers) {
+                sub_header.eventNumber += events_consumed_;
+                sub_header.timeStamp += particle_offset;
+            }
+        } else {
+            for (auto& sub_header : staged.sub_event_headers) {
+                sub_header.timeStamp += particle_offset;
+            }
+        }
+        append(collections_.sub_event_headers, staged.sub_event_headers);
+        append(collections_.sub_event_header_weights, staged.sub_event_header_weights);
+
+        for (const auto& name : tracker_collection_names_) {
+            append(collections_.tracker_hits[name], staged.tracker_hits[name]);
+            shiftRefs(staged.tracker_hit_particle_refs[name], particle_offset);
+            append(collections_.tracker_hit_particle_refs[name], staged.tracker_hit_particle_refs[name]);
+        }
+
+        for (const auto& name : calo_collection_names_) {
+            const size_t contribution_offset = collections_.calo_contributions[name].size();
+            for (auto& hit : staged.calo_hits[name]) {
+                hit.contributions_begin += contribution_offset;
+                hit.contributions_end += contribution_offset;
+            }
+            append(collections_.calo_hits[name], staged.calo_hits[name]);
+            shiftRefs(staged.calo_hit_contributions_refs[name], contribution_offset);
+            append(collections_.calo_hit_contributions_refs[name], staged.calo_hit_contributions_refs[name]);
+            append(collections_.calo_contributions[name], staged.calo_contributions[name]);
+            shiftRefs(staged.calo_contrib_particle_refs[name], particle_offset);
+            append(collections_.calo_contrib_particle_refs[name], staged.calo_contrib_particle_refs[name]);
+        }
+
+        for (const auto& name : gp_collection_names_) {
+            append(collections_.gp_key_branches[name], staged.gp_key_branches[name]);
+        }
+        append(collections_.gp_int_values, staged.gp_int_values);
+        append(collections_.gp_float_values, staged.gp_float_values);
+        append(collections_.gp_double_values, staged.gp_double_values);
+        append(collections_.gp_string_values, staged.gp_string_values);
+
+        events_consumed_ += staging.events;
+        timeframe_events_ += staging.events;
+    }
 }
 
 void EDM4hepDataHandler::writeTimeframe() {
@@ -254,6 +761,16 @@ void EDM4hepDataHandler::writeTimeframe() {
         throw std::runtime_error("Output tree not initialized");
     }
     
+    if (!time_windows_.empty()) {
+        applyTimeWindows();
+    }
+    if (config_ && config_->calo_pileup) {
+        combineCaloPileup();
+    }
+    if (sort_pool_) {
+        sortByTime();
+    }
+
     // Create main timeframe header
     edm4hep::EventHeaderData header;
     header.eventNumber = current_timeframe_number_;
@@ -263,6 +780,10 @@ void EDM4hepDataHandler::writeTimeframe() {
     
     output_tree_->Fill();
     std::cout << "=== Timeframe written ===" << std::endl;
+
+    if (io_budget_) {
+        io_budget_->endTimeframe();
+    }
 }
 
 void EDM4hepDataHandler::finalize() {
@@ -276,52 +797,382 @@ void EDM4hepDataHandler::finalize() {
         output_file_->Write(nullptr, TObject::kOverwrite);
         output_file_->Close();
     }
+    if (capacity_manager_) {
+        capacity_manager_->printStatistics();
+    }
+    if (io_budget_) {
+        io_budget_->printAllocation();
+    }
+    if (config_ && config_->calo_pileup) {
+        std::cout << "Calorimeter pile-up combined " << pileup_combined_hits_ << " hits into hits of the same cell" << std::endl;
+    }
+    if (!time_windows_.empty()) {
+        std::cout << "Time windows dropped " << dropped_tracker_hits_ << " tracker hits, " << dropped_contributions_
+                  << " calorimeter contributions and " << dropped_calo_hits_ << " calorimeter hits" << std::endl;
+    }
+    for (auto* edm4hep_source : edm4hep_sources_) {
+        const auto& source_config = edm4hep_source->getConfig();
+        auto it = input_readers_.find(EDM4hepInputReader::key(source_config.tree_name, source_config.input_files,
+                                                              source_config.already_merged));
+        if (it != input_readers_.end() && it->second->getUsers() > 1) {
+            it->second->printStatistics(source_config.name);
+            input_readers_.erase(it);
+        }
+    }
     std::cout << "EDM4hep output finalized" << std::endl;
 }
 
+void EDM4hepDataHandler::collectMemoryUsage(MemoryUsage& usage) const {
+    collections_.collectMemoryUsage(usage);
+    for (const auto& staging : staging_) {
+        staging.collections.collectMemoryUsage(usage, "staging_" + staging.name);
+    }
+    if (config_ && config_->signal_multiplex > 1) {
+        background_.collectMemoryUsage(usage, "background");
+    }
+    for (const auto& [source_index, readers] : chunk_readers_) {
+        for (const auto& reader : readers) {
+            reader->collectMemoryUsage(usage);
+        }
+    }
+    // Output baskets are only valid while the file is open
+    if (output_file_ && output_file_->IsOpen()) {
+        memory_accounting::accountTree(usage, "output", output_tree_);
+    }
+}
+
 void EDM4hepDataHandler::setupOutputTree() {
     if (!output_tree_) {
         throw std::runtime_error("Cannot setup output tree - tree is null");
     }
     
-    // Create all required branches
-    output_tree_->Branch("EventHeader", &collections_.event_headers);
-    output_tree_->Branch("_EventHeader_weights", &collections_.event_header_weights);
-    output_tree_->Branch("SubEventHeaders", &collections_.sub_event_headers);
-    output_tree_->Branch("_SubEventHeader_weights", &collections_.sub_event_header_weights);
-    output_tree_->Branch("MCParticles", &collections_.mcparticles);
-    output_tree_->Branch("_MCParticles_daughters", &collections_.mcparticle_daughters_refs);
-    output_tree_->Branch("_MCParticles_parents", &collections_.mcparticle_parents_refs);
+    collections_.setupBranches(output_tree_, tracker_collection_names_, calo_collection_names_, gp_collection_names_);
+    if (lazy_time_offsets_) {
+        collections_.setupSubEventOffsetBranches(output_tree_, time_collection_names_);
+    }
+    
+    std::cout << "Total branches created: " << output_tree_->GetListOfBranches()->GetEntries() << std::endl;
+}
+
+void EDM4hepDataHandler::setupTimeWindows() {
+    time_windows_.clear();
+    if (!config_ || config_->time_windows.empty()) return;
+
+    // "*" applies to every collection first, the windows of named collections override it
+    auto apply = [this](const std::string& name, const CollectionTimeWindow& window) {
+        time_windows_[name] = {window.t_min, window.t_max};
+    };
+    for (const auto& window : config_->time_windows) {
+        if (window.collection != "*") continue;
+        for (const auto& name : tracker_collection_names_) apply(name, window);
+        for (const auto& name : calo_collection_names_) apply(name, window);
+    }
+    for (const auto& window : config_->time_windows) {
+        if (window.collection == "*") continue;
+        const bool known =
+            std::find(tracker_collection_names_.begin(), tracker_collection_names_.end(), window.collection) !=
+                tracker_collection_names_.end() ||
+            std::find(calo_collection_names_.begin(), calo_collection_names_.end(), window.collection) !=
+                calo_collection_names_.end();
+        if (!known) {
+            std::cout << "Warning: time window for unknown collection " << window.collection << " ignored" << std::endl;
+            continue;
+        }
+        apply(window.collection, window);
+    }
+}
+
+void EDM4hepDataHandler::applyTimeWindows() {
+    const auto& offsets = collections_.sub_event_time_offsets;
+    auto lazyBegins = [this](const std::string& name) {
+        return lazy_time_offsets_ ? &collections_.sub_event_begins[name] : nullptr;
+    };
+    // Sub-event ranges start at the new index of their first element
+    auto remapBegins = [this](const std::string& name, const std::vector<uint32_t>& kept_before) {
+        if (!lazy_time_offsets_) return;
+        for (auto& begin : collections_.sub_event_begins[name]) {
+            begin = kept_before[begin];
+        }
+    };
 
-    // Tracker collections and their references
     for (const auto& name : tracker_collection_names_) {
-        output_tree_->Branch(name.c_str(), &collections_.tracker_hits[name]);        
-        std::string ref_name = "_" + name + "_particle";
-        output_tree_->Branch(ref_name.c_str(), &collections_.tracker_hit_particle_refs[name]);
+        auto window = time_windows_.find(name);
+        if (window == time_windows_.end()) continue;
+        auto& hits = collections_.tracker_hits[name];
+        const size_t kept = indexInWindow(hits, window->second.t_min, window->second.t_max, offsets,
+                                          lazyBegins(name), window_index_);
+        if (kept == hits.size()) continue;
+
+        dropped_tracker_hits_ += hits.size() - kept;
+        compactInWindow(collections_.tracker_hit_particle_refs[name], window_index_);
+        compactInWindow(hits, window_index_);
+        remapBegins(name, window_index_);
     }
 
-    // Calorimeter collections and their references
     for (const auto& name : calo_collection_names_) {
-        output_tree_->Branch(name.c_str(), &collections_.calo_hits[name]);        
-        std::string ref_name = "_" + name + "_contributions";
-        output_tree_->Branch(ref_name.c_str(), &collections_.calo_hit_contributions_refs[name]);        
-        std::string contrib_name = name + "Contributions";
-        output_tree_->Branch(contrib_name.c_str(), &collections_.calo_contributions[name]);        
-        std::string ref_name_contrib = "_" + contrib_name + "_particle";
-        output_tree_->Branch(ref_name_contrib.c_str(), &collections_.calo_contrib_particle_refs[name]);
+        auto window = time_windows_.find(name);
+        if (window == time_windows_.end()) continue;
+        const std::string contrib_name = name + "Contributions";
+        auto& contributions = collections_.calo_contributions[name];
+        const size_t kept = indexInWindow(contributions, window->second.t_min, window->second.t_max, offsets,
+                                          lazyBegins(contrib_name), window_index_);
+        if (kept == contributions.size()) continue;
+        dropped_contributions_ += contributions.size() - kept;
+
+        // Keep the references to kept contributions, remapped, and the energy they carry;
+        // hits left without contributions are dropped
+        auto& hits = collections_.calo_hits[name];
+        auto& contribution_refs = collections_.calo_hit_contributions_refs[name];
+        size_t refs_kept = 0;
+        size_t hits_kept = 0;
+        for (auto hit : hits) {
+            const size_t first_ref = refs_kept;
+            for (size_t r = hit.contributions_begin; r < hit.contributions_end && r < contribution_refs.size(); ++r) {
+                auto ref = contribution_refs[r];
+                const auto index = static_cast<size_t>(ref.index);
+                if (ref.index < 0 || index >= contributions.size()) {
+                    contribution_refs[refs_kept++] = ref;
+                } else if (window_index_[index + 1] > window_index_[index]) {
+                    ref.index = window_index_[index];
+                    contribution_refs[refs_kept++] = ref;
+                } else {
+                    hit.energy -= contributions[index].energy;
+                }
+            }
+            if (refs_kept == first_ref) {
+                ++dropped_calo_hits_;
+                continue;
+            }
+            hit.contributions_begin = first_ref;
+            hit.contributions_end = refs_kept;
+            hits[hits_kept++] = hit;
+        }
+        contribution_refs.resize(refs_kept);
+        hits.resize(hits_kept);
+
+        compactInWindow(collections_.calo_contrib_particle_refs[name], window_index_);
+        compactInWindow(contributions, window_index_);
+        remapBegins(contrib_name, window_index_);
     }
-    
-    // GP (Global Parameter) branches
-    for (const auto& name : gp_collection_names_) {
-        output_tree_->Branch(name.c_str(), &collections_.gp_key_branches[name]);
+}
+
+void EDM4hepDataHandler::combineCaloPileup() {
+    for (const auto& name : calo_collection_names_) {
+        auto& hits = collections_.calo_hits[name];
+        auto& contribution_refs = collections_.calo_hit_contributions_refs[name];
+        const auto& contributions = collections_.calo_contributions[name];
+        if (hits.size() < 2) continue;
+
+        // First hit of each cell, with the energy of the later ones added
+        cell_hits_.reset(hits.size());
+        pileup_hits_.clear();
+        pileup_hit_of_.resize(hits.size());
+        pileup_cursor_.clear();
+        for (size_t h = 0; h < hits.size(); ++h) {
+            const auto& hit = hits[h];
+            const auto [combined, inserted] = cell_hits_.insert(hit.cellID, static_cast<uint32_t>(pileup_hits_.size()));
+            if (inserted) {
+                pileup_hits_.push_back(hit);
+                pileup_cursor_.push_back(0);
+            } else {
+                pileup_hits_[combined].energy += hit.energy;
+            }
+            pileup_hit_of_[h] = combined;
+            const size_t end = std::min<size_t>(hit.contributions_end, contribution_refs.size());
+            if (end > hit.contributions_begin) {
+                pileup_cursor_[combined] += end - hit.contributions_begin;
+            }
+        }
+        if (pileup_hits_.size() == hits.size()) continue;
+        pileup_combined_hits_ += hits.size() - pileup_hits_.size();
+
+        // Reference ranges of the combined hits, laid out back to back
+        uint32_t start = 0;
+        for (size_t c = 0; c < pileup_hits_.size(); ++c) {
+            const uint32_t count = pileup_cursor_[c];
+            pileup_hits_[c].contributions_begin = start;
+            pileup_hits_[c].contributions_end = start + count;
+            pileup_cursor_[c] = start;
+            start += count;
+        }
+        pileup_refs_.resize(start);
+        for (size_t h = 0; h < hits.size(); ++h) {
+            const size_t end = std::min<size_t>(hits[h].contributions_end, contribution_refs.size());
+            for (size_t r = hits[h].contributions_begin; r < end; ++r) {
+                pileup_refs_[pileup_cursor_[pileup_hit_of_[h]]++] = contribution_refs[r];
+            }
+        }
+
+        // Contribution times, shifted once by walking the sub-event ranges with lazy offsets
+        pileup_contribution_times_.resize(contributions.size());
+        for (size_t i = 0; i < contributions.size(); ++i) {
+            pileup_contribution_times_[i] = contributions[i].time;
+        }
+        if (lazy_time_offsets_) {
+            const auto& begins = collections_.sub_event_begins[name + "Contributions"];
+            const auto& offsets = collections_.sub_event_time_offsets;
+            for (size_t sub_event = 0; sub_event < begins.size(); ++sub_event) {
+                const size_t end = sub_event + 1 < begins.size() ? begins[sub_event + 1] : contributions.size();
+                for (size_t i = begins[sub_event]; i < std::min(end, contributions.size()); ++i) {
+                    pileup_contribution_times_[i] += offsets[sub_event];
+                }
+            }
+        }
+
+        // Contributions of each combined hit in time order, the earliest first
+        pileup_timed_refs_.resize(pileup_refs_.size());
+        for (size_t r = 0; r < pileup_refs_.size(); ++r) {
+            const auto& ref = pileup_refs_[r];
+            const bool valid = ref.index >= 0 && static_cast<size_t>(ref.index) < contributions.size();
+            pileup_timed_refs_[r] = {valid ? pileup_contribution_times_[ref.index] : std::numeric_limits<float>::max(), ref};
+        }
+        for (const auto& hit : pileup_hits_) {
+            if (hit.contributions_end - hit.contributions_begin < 2) continue;
+            const auto first = pileup_timed_refs_.begin() + hit.contributions_begin;
+            const auto last = pileup_timed_refs_.begin() + hit.contributions_end;
+            std::stable_sort(first, last, [](const auto& a, const auto& b) { return a.first < b.first; });
+            for (auto it = first; it != last; ++it) {
+                pileup_refs_[it - pileup_timed_refs_.begin()] = it->second;
+            }
+        }
+
+        // Swapping keeps the output vectors in place; the old contents become the next scratch
+        hits.swap(pileup_hits_);
+        contribution_refs.swap(pileup_refs_);
     }
-    
-    output_tree_->Branch("GPIntValues", &collections_.gp_int_values);    
-    output_tree_->Branch("GPFloatValues", &collections_.gp_float_values);    
-    output_tree_->Branch("GPDoubleValues", &collections_.gp_double_values);    
-    output_tree_->Branch("GPStringValues", &collections_.gp_string_values);
-    
-    std::cout << "Total branches created: " << output_tree_->GetListOfBranches()->GetEntries() << std::endl;
+}
+
+void EDM4hepDataHandler::setupTimeSort() {
+    // Small collections are sorted concurrently, each by one thread; large ones use all threads
+    const size_t n_tasks = tracker_collection_names_.size() + calo_collection_names_.size();
+    const size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t n_threads = config_->merge_threads > 0 ? config_->merge_threads : hardware_threads;
+    sort_pool_ = std::make_unique<ThreadPool>(std::max<size_t>(n_threads, 1));
+    sort_scratch_.resize(n_tasks);
+    std::cout << "Sorting " << n_tasks << " hit collections by time on " << sort_pool_->size() << " threads" << std::endl;
+}
+
+void EDM4hepDataHandler::sortByTime() {
+    // Create every map entry up front, the tasks only look them up
+    for (const auto& name : tracker_collection_names_) {
+        collections_.tracker_hits[name];
+        collections_.tracker_hit_particle_refs[name];
+    }
+    for (const auto& name : calo_collection_names_) {
+        collections_.calo_hits[name];
+        collections_.calo_hit_contributions_refs[name];
+        collections_.calo_contributions[name];
+        collections_.calo_contrib_particle_refs[name];
+    }
+
+    const size_t n_tracker = tracker_collection_names_.size();
+    auto sortTask = [this, n_tracker](size_t task, ThreadPool* pool) {
+        if (task < n_tracker) {
+            sortTrackerHits(tracker_collection_names_[task], sort_scratch_[task], pool);
+        } else {
+            sortCaloHits(calo_collection_names_[task - n_tracker], sort_scratch_[task], pool);
+        }
+    };
+
+    // A frame dominated by one large collection would otherwise sort on a single thread
+    sort_tasks_.clear();
+    split_sort_tasks_.clear();
+    for (size_t task = 0; task < sort_scratch_.size(); ++task) {
+        const size_t size = task < n_tracker
+            ? collections_.tracker_hits[tracker_collection_names_[task]].size()
+            : collections_.calo_contributions[calo_collection_names_[task - n_tracker]].size();
+        auto& tasks = sort_pool_->size() > 1 && size >= kParallelSortMinElements ? split_sort_tasks_ : sort_tasks_;
+        tasks.push_back(task);
+    }
+    sort_pool_->parallelFor(sort_tasks_.size(), [&](size_t i) { sortTask(sort_tasks_[i], nullptr); });
+    for (size_t task : split_sort_tasks_) {
+        sortTask(task, sort_pool_.get());
+    }
+}
+
+void EDM4hepDataHandler::sortTrackerHits(const std::string& name, SortScratch& scratch, ThreadPool* pool) {
+    auto& hits = collections_.tracker_hits.at(name);
+    auto& particle_refs = collections_.tracker_hit_particle_refs.at(name);
+    const auto& order = timeOrder(hits, [](const auto& hit) { return hit.time; }, scratch.radix, pool);
+    applyTimeOrder(hits, order, scratch.visited, scratch.tracker_hits, pool);
+    if (particle_refs.size() == hits.size()) {
+        applyTimeOrder(particle_refs, order, scratch.visited, scratch.refs, pool);
+    }
+}
+
+void EDM4hepDataHandler::sortCaloHits(const std::string& name, SortScratch& scratch, ThreadPool* pool) {
+    auto& hits = collections_.calo_hits.at(name);
+    auto& contribution_refs = collections_.calo_hit_contributions_refs.at(name);
+    auto& contributions = collections_.calo_contributions.at(name);
+    auto& particle_refs = collections_.calo_contrib_particle_refs.at(name);
+
+    // Contributions by time; the hits' references follow them to their new positions
+    const auto& contribution_order =
+        timeOrder(contributions, [](const auto& contribution) { return contribution.time; }, scratch.radix, pool);
+    applyTimeOrder(contributions, contribution_order, scratch.visited, scratch.contributions, pool);
+    if (particle_refs.size() == contributions.size()) {
+        applyTimeOrder(particle_refs, contribution_order, scratch.visited, scratch.refs, pool);
+    }
+    scratch.inverse.resize(contributions.size());
+    forEachBlock(pool, contribution_order.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            scratch.inverse[contribution_order[i]] = static_cast<uint32_t>(i);
+        }
+    });
+    forEachBlock(pool, contribution_refs.size(), [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            auto& ref = contribution_refs[r];
+            if (ref.index >= 0 && static_cast<size_t>(ref.index) < contributions.size()) {
+                ref.index = scratch.inverse[ref.index];
+            }
+        }
+    });
+
+    // Hits by their earliest contribution
+    scratch.hit_times.resize(hits.size());
+    forEachBlock(pool, hits.size(), [&](size_t begin, size_t end) {
+        for (size_t h = begin; h < end; ++h) {
+            float earliest = std::numeric_limits<float>::max();
+            for (size_t r = hits[h].contributions_begin; r < hits[h].contributions_end && r < contribution_refs.size(); ++r) {
+                const auto index = contribution_refs[r].index;
+                if (index >= 0 && static_cast<size_t>(index) < contributions.size()) {
+                    earliest = std::min(earliest, contributions[index].time);
+                }
+            }
+            scratch.hit_times[h] = earliest;
+        }
+    });
+    const auto& hit_order = timeOrder(scratch.hit_times, [](float time) { return time; }, scratch.radix, pool);
+    applyTimeOrder(hits, hit_order, scratch.visited, scratch.calo_hits, pool);
+
+    // Rewrite the references contiguously in the new hit order
+    scratch.refs.clear();
+    for (auto& hit : hits) {
+        const size_t begin = scratch.refs.size();
+        for (size_t r = hit.contributions_begin; r < hit.contributions_end && r < contribution_refs.size(); ++r) {
+            scratch.refs.push_back(contribution_refs[r]);
+        }
+        hit.contributions_begin = begin;
+        hit.contributions_end = scratch.refs.size();
+    }
+    contribution_refs.swap(scratch.refs);
+}
+
+void EDM4hepDataHandler::setupIOBudget() {
+    if (!config_ || config_->io_memory_budget_mb <= 0.0f) {
+        return;
+    }
+
+    io_budget_ = std::make_unique<IOBudgetManager>(
+        static_cast<size_t>(config_->io_memory_budget_mb * 1024.0 * 1024.0), config_->io_rebalance_interval);
+
+    for (auto* edm4hep_source : edm4hep_sources_) {
+        const auto& source_config = edm4hep_source->getConfig();
+
+        io_budget_->addChain(edm4hep_source->getInputReader()->getChain(), source_config.name,
+                             edm4hep_source->expectedEntriesPerTimeframe(config_->timeframe_duration));
+    }
+    io_budget_->allocate();
 }
 
 void EDM4hepDataHandler::discoverCollections(const std::vector<std::unique_ptr<DataSource>>& sources) {
@@ -333,6 +1184,13 @@ void EDM4hepDataHandler::discoverCollections(const std::vector<std::unique_ptr<D
     tracker_collection_names_ = discoverCollectionNames(*sources[0], "SimTrackerHit");
     calo_collection_names_ = discoverCollectionNames(*sources[0], "SimCalorimeterHit");
     gp_collection_names_ = discoverGPBranches(*sources[0]);
+
+    time_collection_names_ = {"MCParticles"};
+    time_collection_names_.insert(time_collection_names_.end(), tracker_collection_names_.begin(),
+                                  tracker_collection_names_.end());
+    for (const auto& name : calo_collection_names_) {
+        time_collection_names_.push_back(name + "Contributions");
+    }
     
     std::cout << "EDM4hep collection names discovered:" << std::endl;
     std::cout << "  Tracker: ";
@@ -445,44 +1303,10 @@ void EDM4hepDataHandler::copyPodioMetadata(const std::vector<std::unique_ptr<Dat
         return;
     }
     
-    output_file_->cd();
-    
-    std::vector<std::string> metadata_trees = {"podio_metadata", "runs", "meta", "metadata"};
-    
-    for (const auto& tree_name : metadata_trees) {
-        TTree* metadata_tree = dynamic_cast<TTree*>(source_file->Get(tree_name.c_str()));
-        if (metadata_tree) {
-            std::cout << "Found metadata tree: " << tree_name << std::endl;
-            if (tree_name == "podio_metadata") {
-                copyAndUpdatePodioMetadataTree(metadata_tree, output_file_.get());
-            } else {
-                TTree* output_metadata = metadata_tree->CloneTree(-1, "fast");
-                if (output_metadata) {
-                    output_metadata->SetDirectory(output_file_.get());
-                    std::cout << "Successfully cloned metadata tree: " << tree_name << std::endl;
-                }
-            }
-        }
-    }
-    
+    timeframe_concat::copyMetadataTrees(*source_file, *output_file_);
     source_file->Close();
 }
 
-void EDM4hepDataHandler::copyAndUpdatePodioMetadataTree(TTree* source_metadata_tree, TFile* output_file) {
-    if (!source_metadata_tree || !output_file) {
-        std::cout << "Warning: Cannot copy podio_metadata tree - null pointer" << std::endl;
-        return;
-    }
-    
-    TTree* output_metadata = source_metadata_tree->CloneTree(-1, "fast");
-    if (output_metadata) {
-        output_metadata->SetDirectory(output_file);
-        std::cout << "Successfully copied podio_metadata tree with " << output_metadata->GetEntries() << " entries" << std::endl;
-    } else {
-        std::cout << "Warning: Failed to clone podio_metadata tree" << std::endl;
-    }
-}
-
 std::string EDM4hepDataHandler::getCorrespondingContributionCollection(const std::string& calo_collection_name) const {
     return calo_collection_name + "Contributions";
 }
@@ -1,4 +1,5 @@
 #include "EDM4hepDataSource.h"
+#include "SubEventTimeOffsets.h"
 #include <iostream>
 #include <algorithm>
 #include <cmath>
@@ -8,11 +9,7 @@
 EDM4hepDataSource::EDM4hepDataSource(const SourceConfig& config, size_t source_index)
     : tracker_collection_names_(nullptr)
     , calo_collection_names_(nullptr)
-    , mcparticle_branch_(nullptr)
-    , gp_int_branch_(nullptr)
-    , gp_float_branch_(nullptr)
-    , gp_double_branch_(nullptr)
-    , gp_string_branch_(nullptr)
+    , gp_collection_names_(nullptr)
     , current_particle_index_offset_(0)
 {
     config_ = &config;
@@ -22,10 +19,6 @@ EDM4hepDataSource::EDM4hepDataSource(const SourceConfig& config, size_t source_i
     entries_needed_ = 1;
 }
 
-EDM4hepDataSource::~EDM4hepDataSource() {
-    cleanup();
-}
-
 void EDM4hepDataSource::initialize(const std::vector<std::string>& tracker_collections,
                                    const std::vector<std::string>& calo_collections,
                                    const std::vector<std::string>& gp_collections) {
@@ -36,28 +29,33 @@ void EDM4hepDataSource::initialize(const std::vector<std::string>& tracker_colle
     
     if (!config_->input_files.empty()) {
         try {
-            // Create TChain for this source
-            chain_ = std::make_unique<TChain>(config_->tree_name.c_str());
-            
-            // Add all input files to the chain
-            for (const auto& file : config_->input_files) {
-                int result = chain_->Add(file.c_str());
-                if (result == 0) {
-                    throw std::runtime_error("Failed to add file: " + file);
-                }
-                std::cout << "Added file to source " << source_index_ << ": " << file << std::endl;
+            // Open a private reader unless the handler assigned a shared one
+            if (!reader_) {
+                reader_ = std::make_shared<EDM4hepInputReader>(config_->tree_name, config_->input_files);
+                reader_->addUser();
             }
-            
-            total_entries_ = chain_->GetEntries();
-            
-            if (total_entries_ == 0) {
-                throw std::runtime_error("No entries found in source " + std::to_string(source_index_));
+            if (!reader_->reporter) {
+                reader_->reporter = this;
             }
+            
+            total_entries_ = reader_->getEntries();
 
-            std::cout << "Source " << source_index_ << " has " << total_entries_ << " entries" << std::endl;
+            std::cout << "Source " << source_index_ << " has " << total_entries_ << " entries";
+            if (reader_->getUsers() > 1) {
+                std::cout << " (reader shared by " << reader_->getUsers() << " sources)";
+            }
+            std::cout << std::endl;
+            restrictToEntryPart();
             
             // Setup branch addresses
             setupBranches();
+
+            // Lazily offset timeframes would need their sub-event offsets carried over
+            if (config_->already_merged &&
+                reader_->getChain()->GetBranch(SubEventTimeOffsets::offsetsBranch().c_str())) {
+                throw std::runtime_error("source " + config_->name + " was written with lazy time offsets, "
+                                         "which cannot be merged again");
+            }
             
             std::cout << "Successfully initialized EDM4hep source " << source_index_ << " (" << config_->name << ")" << std::endl;
 
@@ -83,12 +81,16 @@ bool EDM4hepDataSource::loadNextEvent() {
         return false;
     }
     
-    chain_->GetEntry(current_entry_index_);
+    reader_->read(entry_offset_ + current_entry_index_, *buffers_);
     return true;
 }
 
 void EDM4hepDataSource::loadEvent(size_t event_index) {
-    chain_->GetEntry(event_index);
+    // Wrap around the input when repeating it
+    if (config_->repeat_on_eof && total_entries_ > 0) {
+        event_index %= total_entries_;
+    }
+    reader_->read(entry_offset_ + event_index, *buffers_);
 }
 
 std::vector<podio::ObjectID>& EDM4hepDataSource::processObjectID(const std::string& branch_name, 
@@ -96,22 +98,22 @@ std::vector<podio::ObjectID>& EDM4hepDataSource::processObjectID(const std::stri
     
     //If first event and already merged, skip updating references
     if (totalEventsConsumed == 0 && config_->already_merged) {
-        return *objectid_branches_[branch_name];
+        return *buffers_->objectids[branch_name];
     }
 
     // Update references with index offset
-    for (auto& ref : *objectid_branches_[branch_name]) {
+    for (auto& ref : *buffers_->objectids[branch_name]) {
         ref.index += index_offset;
     }
 
-    return *objectid_branches_[branch_name];
+    return *buffers_->objectids[branch_name];
 }
 
 std::vector<edm4hep::MCParticleData>& EDM4hepDataSource::processMCParticles(size_t particle_parents_offset,
                                                                             size_t particle_daughters_offset,
                                                                             int totalEventsConsumed) {
 
-    auto& particles = *mcparticle_branch_;
+    auto& particles = *buffers_->mcparticles;
 
     if (totalEventsConsumed == 0 && config_->already_merged) {
         return particles;
@@ -122,7 +124,9 @@ std::vector<edm4hep::MCParticleData>& EDM4hepDataSource::processMCParticles(size
     // Work directly on the branch data
     for (auto& particle : particles) {
         if (!config_->already_merged) {
-            particle.time += current_time_offset_;
+            if (!lazy_time_offsets_) {
+                particle.time += current_time_offset_;
+            }
             // Update generator status offset
             particle.generatorStatus += config_->generator_status_offset;
         }
@@ -142,17 +146,17 @@ std::vector<edm4hep::SimTrackerHitData>& EDM4hepDataSource::processTrackerHits(c
                                                                               int totalEventsConsumed) {
                                                         
     if(totalEventsConsumed == 0 && config_->already_merged) {
-        return *tracker_hit_branches_[collection_name];
+        return *buffers_->tracker_hits[collection_name];
     }
 
-    // Apply index offset to particle references in hits
-    if (!config_->already_merged) {
-        for (auto& hit : *tracker_hit_branches_[collection_name]) {// Apply time offset if not already merged
+    // Apply the time offset unless it is recorded per sub-event instead
+    if (!config_->already_merged && !lazy_time_offsets_) {
+        for (auto& hit : *buffers_->tracker_hits[collection_name]) {// Apply time offset if not already merged
             hit.time += current_time_offset_;
         }
     }
 
-    return *tracker_hit_branches_[collection_name]; // Return reference to the branch data itself
+    return *buffers_->tracker_hits[collection_name]; // Return reference to the branch data itself
 }
 
 
@@ -161,10 +165,10 @@ std::vector<edm4hep::SimCalorimeterHitData>& EDM4hepDataSource::processCaloHits(
                                                                                int totalEventsConsumed) {
 
     if(totalEventsConsumed == 0 && config_->already_merged) {
-        return *calo_hit_branches_[collection_name];
+        return *buffers_->calo_hits[collection_name];
     }
 
-    auto& hits = *calo_hit_branches_[collection_name];
+    auto& hits = *buffers_->calo_hits[collection_name];
 
     for (auto& hit : hits) {
         hit.contributions_begin += contribution_index_offset;
@@ -178,14 +182,14 @@ std::vector<edm4hep::CaloHitContributionData>& EDM4hepDataSource::processCaloCon
                                                                                           size_t particle_index_offset,
                                                                                           int totalEventsConsumed) {
 
-    auto& contribs = *calo_contrib_branches_[collection_name];
+    auto& contribs = *buffers_->calo_contributions[collection_name];
 
     if(totalEventsConsumed == 0 && config_->already_merged) {
         return contribs;
     }
     
-    // Apply time offset if not already merged - work directly on branch data
-    if (!config_->already_merged) {
+    // Apply time offset if not already merged (nor recorded per sub-event) - work directly on branch data
+    if (!config_->already_merged && !lazy_time_offsets_) {
         for (auto& contrib : contribs) {
             contrib.time += current_time_offset_;
         }
@@ -196,17 +200,17 @@ std::vector<edm4hep::CaloHitContributionData>& EDM4hepDataSource::processCaloCon
 
 std::vector<edm4hep::EventHeaderData>& EDM4hepDataSource::processEventHeaders(const std::string& collection_name) {
     // Check if the collection exists in our event header branches
-    if (event_header_branches_.find(collection_name) == event_header_branches_.end()) {
+    if (buffers_->event_headers.find(collection_name) == buffers_->event_headers.end()) {
         // Collection not found, return empty vector
-        static std::vector<edm4hep::EventHeaderData> empty_headers;
+        thread_local std::vector<edm4hep::EventHeaderData> empty_headers;
         empty_headers.clear();
         return empty_headers;
     }
     
     // Get the current event headers
-    auto* headers = event_header_branches_[collection_name];
+    auto* headers = buffers_->event_headers[collection_name];
     if (!headers) {
-        static std::vector<edm4hep::EventHeaderData> empty_headers;
+        thread_local std::vector<edm4hep::EventHeaderData> empty_headers;
         empty_headers.clear();
         return empty_headers;
     }
@@ -217,169 +221,78 @@ std::vector<edm4hep::EventHeaderData>& EDM4hepDataSource::processEventHeaders(co
 
 void EDM4hepDataSource::setupBranches() {
     std::cout << "=== Setting up EDM4hep branches for source " << source_index_ << " ===" << std::endl;
-    
-    setupMCParticleBranches();
-    setupTrackerBranches();
-    setupCalorimeterBranches();
-    setupEventHeaderBranches();
-    setupGPBranches();
-    
-    std::cout << "=== EDM4hep branch setup complete ===" << std::endl;
-}
-
-void EDM4hepDataSource::setupMCParticleBranches() {
-    // Setup MCParticles branch
-    mcparticle_branch_ = new std::vector<edm4hep::MCParticleData>();
-    int result = chain_->SetBranchAddress("MCParticles", &mcparticle_branch_);
-
-    // Setup MCParticle parent-child relationship branches using consolidated map
-    std::string parents_branch_name = "_MCParticles_parents";
-    std::string children_branch_name = "_MCParticles_daughters";
-    
-    objectid_branches_[parents_branch_name] = new std::vector<podio::ObjectID>();
-    objectid_branches_[children_branch_name] = new std::vector<podio::ObjectID>();
-    
-    result = chain_->SetBranchAddress(parents_branch_name.c_str(), &objectid_branches_[parents_branch_name]);
-    result = chain_->SetBranchAddress(children_branch_name.c_str(), &objectid_branches_[children_branch_name]);
-}
 
-void EDM4hepDataSource::setupTrackerBranches() {
-    for (const auto& coll_name : *tracker_collection_names_) {
-        tracker_hit_branches_[coll_name] = new std::vector<edm4hep::SimTrackerHitData>();
-        int result = chain_->SetBranchAddress(coll_name.c_str(), &tracker_hit_branches_[coll_name]);
-        
-        // Also setup the particle reference branch using consolidated map
-        std::string ref_branch_name = "_" + coll_name + "_particle";  
-        objectid_branches_[ref_branch_name] = new std::vector<podio::ObjectID>();
-        result = chain_->SetBranchAddress(ref_branch_name.c_str(), &objectid_branches_[ref_branch_name]);
+    // SubEventHeaders only exist in already merged inputs, where they are carried over
+    bool read_sub_event_headers = config_->already_merged;
+    reader_->configure(*tracker_collection_names_, *calo_collection_names_, *gp_collection_names_,
+                       read_sub_event_headers);
+    const std::string& signature = reader_->getSchemaSignature();
+
+    auto create_buffers = [&]() {
+        return std::make_shared<EDM4hepBranchBuffers>(*tracker_collection_names_, *calo_collection_names_,
+                                                      *gp_collection_names_, read_sub_event_headers);
+    };
+    if (buffer_pool_) {
+        size_t pool_size = buffer_pool_->size();
+        buffers_ = buffer_pool_->acquire(signature, create_buffers);
+        if (buffer_pool_->size() > pool_size) {
+            std::cout << "Created shared decode buffers for source " << config_->name << std::endl;
+        } else {
+            std::cout << "Source " << config_->name << " shares existing decode buffers" << std::endl;
+        }
+        if (buffers_->name.empty()) {
+            buffers_->name = "shared_buffers_" + std::to_string(pool_size);
+        }
+    } else {
+        buffers_ = create_buffers();
+        buffers_->name = config_->name;
     }
-}
 
-void EDM4hepDataSource::setupCalorimeterBranches() {
-    // Setup calorimeter hit branches
-    for (const auto& coll_name : *calo_collection_names_) {
-        calo_hit_branches_[coll_name] = new std::vector<edm4hep::SimCalorimeterHitData>();
-        int result = chain_->SetBranchAddress(coll_name.c_str(), &calo_hit_branches_[coll_name]);
-        
-        // Also setup the contributions reference branch using consolidated map
-        std::string contrib_link_branch_name = "_" + coll_name + "_contributions";
-        objectid_branches_[contrib_link_branch_name] = new std::vector<podio::ObjectID>();
-        result = chain_->SetBranchAddress(contrib_link_branch_name.c_str(), &objectid_branches_[contrib_link_branch_name]);
-        
-        std::string contrib_branch_name = coll_name + "Contributions";
-        calo_contrib_branches_[contrib_branch_name] = new std::vector<edm4hep::CaloHitContributionData>();
-        result = chain_->SetBranchAddress(contrib_branch_name.c_str(), &calo_contrib_branches_[contrib_branch_name]);
-        
-        // Also setup the particle reference branch using consolidated map
-        std::string ref_branch_name = "_" + contrib_branch_name + "_particle";  
-        objectid_branches_[ref_branch_name] = new std::vector<podio::ObjectID>();
-        result = chain_->SetBranchAddress(ref_branch_name.c_str(), &objectid_branches_[ref_branch_name]);
+    if (!buffers_->reporter) {
+        buffers_->reporter = this;
     }
-}
 
-void EDM4hepDataSource::setupEventHeaderBranches() {
-    // Setup EventHeader if available
-    std::vector<std::string> header_collections = {"EventHeader"};
-    
-    // Only add SubEventHeaders for non-merged sources (where they aren't already present)
-    if (!config_->already_merged) {
-        header_collections.push_back("SubEventHeaders");
-    }
-    
-    for (const auto& coll_name : header_collections) {
-        event_header_branches_[coll_name] = new std::vector<edm4hep::EventHeaderData>();
-        int result = chain_->SetBranchAddress(coll_name.c_str(), &event_header_branches_[coll_name]);
-    }
-}
-
-void EDM4hepDataSource::setupGPBranches() {
-    // Initialize GP value branch pointers
-    gp_int_branch_ = new std::vector<std::vector<int>>();
-    gp_float_branch_ = new std::vector<std::vector<float>>();
-    gp_double_branch_ = new std::vector<std::vector<double>>();
-    gp_string_branch_ = new std::vector<std::vector<std::string>>();
-    
-    // Setup the fixed GP value branches
-    int result = chain_->SetBranchAddress("GPIntValues", &gp_int_branch_);    
-    result = chain_->SetBranchAddress("GPFloatValues", &gp_float_branch_);
-    result = chain_->SetBranchAddress("GPDoubleValues", &gp_double_branch_);    
-    result = chain_->SetBranchAddress("GPStringValues", &gp_string_branch_);
-    
-    // Setup GP key branches
-    for (const auto& branch_name : *gp_collection_names_) {
-        gp_key_branches_[branch_name] = new std::vector<std::string>();
-        result = chain_->SetBranchAddress(branch_name.c_str(), &gp_key_branches_[branch_name]);
-    }
+    std::cout << "Reading " << reader_->getAvailableBranches().size() << " branches" << std::endl;
+    std::cout << "=== EDM4hep branch setup complete ===" << std::endl;
 }
 
 std::vector<std::string>& EDM4hepDataSource::processGPBranch(const std::string& branch_name) {
     // GP key branches don't need any processing, just return the data as-is
     // They contain global parameter keys that should be copied unchanged
-    return *gp_key_branches_[branch_name];
+    return *buffers_->gp_keys[branch_name];
 }
 
 std::vector<std::vector<int>>& EDM4hepDataSource::processGPIntValues() {
     // GP int values don't need any processing, just return the data as-is
-    return *gp_int_branch_;
+    return *buffers_->gp_int_values;
 }
 
 std::vector<std::vector<float>>& EDM4hepDataSource::processGPFloatValues() {
     // GP float values don't need any processing, just return the data as-is
-    return *gp_float_branch_;
+    return *buffers_->gp_float_values;
 }
 
 std::vector<std::vector<double>>& EDM4hepDataSource::processGPDoubleValues() {
     // GP double values don't need any processing, just return the data as-is
-    return *gp_double_branch_;
+    return *buffers_->gp_double_values;
 }
 
 std::vector<std::vector<std::string>>& EDM4hepDataSource::processGPStringValues() {
     // GP string values don't need any processing, just return the data as-is
-    return *gp_string_branch_;
-}
-
-void EDM4hepDataSource::cleanup() {
-    // Clean up dynamically allocated vectors
-    delete mcparticle_branch_;
-    
-    for (auto& [name, ptr] : tracker_hit_branches_) {
-        delete ptr;
-    }
-    for (auto& [name, ptr] : calo_hit_branches_) {
-        delete ptr;
-    }
-    for (auto& [name, ptr] : calo_contrib_branches_) {
-        delete ptr;
-    }
-    for (auto& [name, ptr] : event_header_branches_) {
-        delete ptr;
-    }
-    for (auto& [name, ptr] : objectid_branches_) {
-        delete ptr;
-    }
-    for (auto& [name, ptr] : gp_key_branches_) {
-        delete ptr;
-    }
-    
-    // Clean up GP value branch pointers
-    delete gp_int_branch_;
-    delete gp_float_branch_;
-    delete gp_double_branch_;
-    delete gp_string_branch_;
+    return *buffers_->gp_string_values;
 }
 
-
 DataSource::VertexPosition EDM4hepDataSource::getBeamVertexPosition() const {
     VertexPosition vertex{0.0f, 0.0f, 0.0f};
     
     // Check if we have particle data
-    if (!mcparticle_branch_ || mcparticle_branch_->empty()) {
+    if (!buffers_ || buffers_->mcparticles->empty()) {
         return vertex;
     }
     
     // Get position of first particle with generatorStatus 1
     try {
-        for (const auto& particle : *mcparticle_branch_) {
+        for (const auto& particle : *buffers_->mcparticles) {
             if (particle.generatorStatus == 1) {
                 vertex.x = particle.vertex.x;
                 vertex.y = particle.vertex.y;
@@ -411,6 +324,16 @@ void EDM4hepDataSource::printStatus() const {
     std::cout << "================================" << std::endl;
 }
 
+void EDM4hepDataSource::collectMemoryUsage(MemoryUsage& usage) const {
+    // Shared buffers and readers are reported once, by their first user
+    if (buffers_ && buffers_->reporter == this) {
+        buffers_->collectMemoryUsage(usage, buffers_->name);
+    }
+    if (reader_ && reader_->reporter == this) {
+        reader_->collectMemoryUsage(usage, config_->name);
+    }
+}
+
 std::string EDM4hepDataSource::getCorrespondingContributionCollection(const std::string& calo_collection_name) const {
     // Add "Contributions" suffix to get the contribution collection name
     return calo_collection_name + "Contributions";
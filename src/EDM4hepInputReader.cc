@@ -0,0 +1,121 @@
+#include "EDM4hepInputReader.h"
+#include <iostream>
+#include <stdexcept>
+
+EDM4hepInputReader::EDM4hepInputReader(const std::string& tree_name, const std::vector<std::string>& files)
+    : chain_(std::make_unique<TChain>(tree_name.c_str()))
+{
+    // Add all input files to the chain
+    for (const auto& file : files) {
+        int result = chain_->Add(file.c_str());
+        if (result == 0) {
+            throw std::runtime_error("Failed to add file: " + file);
+        }
+        std::cout << "Added file to input reader: " << file << std::endl;
+    }
+
+    entries_ = chain_->GetEntries();
+    if (entries_ == 0) {
+        throw std::runtime_error("No entries found in tree " + tree_name);
+    }
+}
+
+std::string EDM4hepInputReader::key(const std::string& tree_name, const std::vector<std::string>& files,
+                                    bool already_merged) {
+    std::string key = tree_name + (already_merged ? "|merged" : "|events");
+    for (const auto& file : files) {
+        key += "|" + file;
+    }
+    return key;
+}
+
+void EDM4hepInputReader::configure(const std::vector<std::string>& tracker_collections,
+                                   const std::vector<std::string>& calo_collections,
+                                   const std::vector<std::string>& gp_collections,
+                                   bool read_sub_event_headers) {
+    if (configured_) return;
+    configured_ = true;
+
+    tracker_collection_names_ = &tracker_collections;
+    calo_collection_names_ = &calo_collections;
+    gp_collection_names_ = &gp_collections;
+    read_sub_event_headers_ = read_sub_event_headers;
+
+    // The schema signature is the set of wanted branches actually present in the input
+    signature_ = chain_->GetName();
+    for (const auto& name : EDM4hepBranchBuffers::branchNames(tracker_collections, calo_collections,
+                                                              gp_collections, read_sub_event_headers)) {
+        if (chain_->GetBranch(name.c_str())) {
+            available_branches_.insert(name);
+            signature_ += "|" + name;
+        }
+    }
+}
+
+void EDM4hepInputReader::read(size_t entry, EDM4hepBranchBuffers& buffers) {
+    if (cache_entries_ > 0) {
+        auto it = cache_index_.find(entry);
+        if (it != cache_index_.end()) {
+            // Move to the front and copy the pristine entry
+            cache_.splice(cache_.begin(), cache_, it->second);
+            buffers.copyFrom(*it->second->buffers);
+            ++cache_hits_;
+            return;
+        }
+        ++cache_misses_;
+    }
+
+    // Shared buffers may have been rebound by another reader since we last read into them
+    if (bound_buffers_ != &buffers || buffers.owner != this) {
+        buffers.bind(*chain_, available_branches_);
+        buffers.owner = this;
+        bound_buffers_ = &buffers;
+    }
+    chain_->GetEntry(entry);
+
+    if (cache_entries_ > 0) {
+        storeInCache(entry, buffers);
+    }
+}
+
+void EDM4hepInputReader::storeInCache(size_t entry, const EDM4hepBranchBuffers& buffers) {
+    // Recycle the least recently used copy once the cache is full
+    if (cache_.size() >= cache_entries_) {
+        cache_index_.erase(cache_.back().entry);
+        cache_.splice(cache_.begin(), cache_, std::prev(cache_.end()));
+    } else {
+        cache_.push_front({entry, std::make_unique<EDM4hepBranchBuffers>(*tracker_collection_names_,
+                                                                          *calo_collection_names_,
+                                                                          *gp_collection_names_,
+                                                                          read_sub_event_headers_)});
+    }
+    cache_.front().entry = entry;
+    cache_.front().buffers->copyFrom(buffers);
+    cache_index_[entry] = cache_.begin();
+}
+
+void EDM4hepInputReader::collectMemoryUsage(MemoryUsage& usage, const std::string& owner_name) const {
+    // Decompressed baskets and read cache of the current file in the chain
+    memory_accounting::accountTree(usage, owner_name, chain_.get());
+
+    MemoryUsage cache_usage;
+    for (const auto& cached : cache_) {
+        cached.buffers->collectMemoryUsage(cache_usage, owner_name);
+    }
+    MemoryUsageEntry total{owner_name, "decode_cache", "entries", 0, 0};
+    for (const auto& entry : cache_usage) {
+        total.size_bytes += entry.size_bytes;
+        total.capacity_bytes += entry.capacity_bytes;
+    }
+    if (!cache_.empty()) {
+        usage.push_back(total);
+    }
+}
+
+void EDM4hepInputReader::printStatistics(const std::string& name) const {
+    std::cout << "Input reader " << name << ": " << users_ << " sources";
+    if (cache_entries_ > 0) {
+        std::cout << ", decode cache " << cache_hits_ << " hits / " << cache_misses_ << " misses";
+    }
+    std::cout << std::endl;
+}
@@ -1,4 +1,7 @@
 #include "HepMC3DataHandler.h"
+#include <TROOT.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 
@@ -8,8 +11,39 @@ std::vector<std::unique_ptr<DataSource>> HepMC3DataHandler::initializeDataSource
     
     std::cout << "Initializing HepMC3 data handler for: " << filename << std::endl;
     
+    auto data_sources = createSources(source_configs, config_ ? config_->timeframe_duration : MergerConfig{}.timeframe_duration,
+                                      hepmc3_sources_);
+    
+    // Create the output tree in the layout HepMC3::WriterRootTree writes
+    output_file_ = std::make_unique<TFile>(filename.c_str(), "RECREATE");
+    if (!output_file_ || output_file_->IsZombie()) {
+        throw std::runtime_error("Failed to create HepMC3 output file: " + filename);
+    }
+    output_file_->SetCompressionSettings(getCompressionSettings());
+    output_tree_ = new TTree("hepmc3_tree", "hepmc3_tree");
+    output_tree_->Branch("hepmc3_event", &merged_event_ptr_);
+    output_tree_->Branch("GenRunInfo", &run_info_data_ptr_);
+    
+    std::cout << "HepMC3 data handler initialized with " << hepmc3_sources_.size() << " sources" << std::endl;
+    
+    return data_sources;
+}
+
+std::vector<std::unique_ptr<DataSource>> HepMC3DataHandler::createSources(
+    const std::vector<SourceConfig>& source_configs,
+    float timeframe_duration,
+    std::vector<HepMC3DataSource*>& hepmc3_sources) {
+    
     std::vector<std::unique_ptr<DataSource>> data_sources;
     data_sources.reserve(source_configs.size());
+
+    // Prefetching sources read their chains on background threads
+    for (const auto& source_config : source_configs) {
+        if (source_config.prefetch) {
+            ROOT::EnableThreadSafety();
+            break;
+        }
+    }
     
     // Create HepMC3DataSource objects for each source configuration
     for (size_t source_idx = 0; source_idx < source_configs.size(); ++source_idx) {
@@ -31,7 +65,7 @@ std::vector<std::unique_ptr<DataSource>> HepMC3DataHandler::initializeDataSource
         // Check if this is HepMC3 format
         if (!hasExtension(first_file, ".hepmc3.tree.root")) {
             throw std::runtime_error(
-                "HepMC3DataHandler can only handle .hepmc3.tree.root files. "
+                "HepMC3 input can only be read from .hepmc3.tree.root files. "
                 "Got: " + first_file
             );
         }
@@ -42,130 +76,138 @@ std::vector<std::unique_ptr<DataSource>> HepMC3DataHandler::initializeDataSource
     }
     
     // Store pointers to HepMC3 sources for later use
-    hepmc3_sources_.clear();
-    hepmc3_sources_.reserve(data_sources.size());
+    hepmc3_sources.clear();
+    hepmc3_sources.reserve(data_sources.size());
     for (auto& source : data_sources) {
-        hepmc3_sources_.push_back(dynamic_cast<HepMC3DataSource*>(source.get()));
+        hepmc3_sources.push_back(dynamic_cast<HepMC3DataSource*>(source.get()));
     }
-    
-    // Create HepMC3 writer
-    writer_ = std::make_shared<HepMC3::WriterRootTree>(filename);
-    if (!writer_) {
-        throw std::runtime_error("Failed to create HepMC3 writer for: " + filename);
+
+    // Read ahead deep enough to cover a timeframe in most cases: mean + 3 sigma of the Poisson draw
+    for (auto* source : hepmc3_sources) {
+        const auto& source_config = source->getConfig();
+        if (!source_config.prefetch) continue;
+        size_t depth = source_config.prefetch_depth;
+        if (depth == 0) {
+            double mean = source->expectedEntriesPerTimeframe(timeframe_duration);
+            depth = std::max<size_t>(1, static_cast<size_t>(std::ceil(mean + 3.0 * std::sqrt(mean))));
+        }
+        source->startPrefetch(depth);
+        std::cout << "Prefetching " << depth << " entries ahead for source " << source_config.name << std::endl;
     }
-    
-    std::cout << "HepMC3 data handler initialized with " << hepmc3_sources_.size() << " sources" << std::endl;
-    
+
     return data_sources;
 }
 
 void HepMC3DataHandler::prepareTimeframe() {
-    // Create a new empty event for this timeframe
-    current_timeframe_ = std::make_unique<HepMC3::GenEvent>(
-        HepMC3::Units::GEV,
-        HepMC3::Units::MM
-    );
+    // Reuse the merged arrays of the previous timeframe
+    merged_event_.event_number = 0;
+    merged_event_.momentum_unit = HepMC3::Units::GEV;
+    merged_event_.length_unit = HepMC3::Units::MM;
+    merged_event_.particles.clear();
+    merged_event_.vertices.clear();
+    merged_event_.weights.clear();
+    merged_event_.event_pos = HepMC3::FourVector();
+    merged_event_.links1.clear();
+    merged_event_.links2.clear();
+    merged_event_.attribute_id.clear();
+    merged_event_.attribute_name.clear();
+    merged_event_.attribute_string.clear();
 }
 
-void HepMC3DataHandler::processEvent(DataSource& source) {
-    auto* hepmc3_source = dynamic_cast<HepMC3DataSource*>(&source);
-    if (!hepmc3_source) {
-        throw std::runtime_error("HepMC3DataHandler: Expected HepMC3DataSource");
-    }
-    
+void HepMC3DataHandler::processEvent(HepMC3DataSource& source) {
     const auto& config = source.getConfig();
     double time_offset_ns = source.getCurrentTimeOffset();
     
-    // Get the current event from the HepMC3 source
-    const auto& event = hepmc3_source->getCurrentEvent();
-    
-    // Insert the event into the merged timeframe
-    insertHepMC3Event(event, current_timeframe_, time_offset_ns, config.generator_status_offset);
+    // Append the (filtered) flat event data of the HepMC3 source to the merged timeframe
+    const auto& data = source.getCurrentEventData();
+    const auto& event = HepMC3EventFilter::enabled(config) ? filter_.apply(data, config) : data;
+    appendHepMC3Event(event, merged_event_, time_offset_ns, config.generator_status_offset);
 }
 
-long HepMC3DataHandler::insertHepMC3Event(const HepMC3::GenEvent& inevt,
-                                            std::unique_ptr<HepMC3::GenEvent>& hepframe,
-                                            double time,
-                                            int baseStatus) {
+long HepMC3DataHandler::appendHepMC3Event(const HepMC3::GenEventData& inevt,
+                                          HepMC3::GenEventData& frame,
+                                          double time,
+                                          int baseStatus) {
     // Convert time in nanoseconds to HepMC position units (mm)
     double timeHepmc = c_light * time;
-    
-    std::vector<HepMC3::GenParticlePtr> particles;
-    std::vector<HepMC3::GenVertexPtr> vertices;
 
-    // Copy vertices with time offset applied
-    for (const auto& vertex : inevt.vertices()) {
-        HepMC3::FourVector position = vertex->position();
-        position.set_t(position.t() + timeHepmc);
-        auto v1 = std::make_shared<HepMC3::GenVertex>(position);
-        vertices.push_back(v1);
+    const size_t n_particles = inevt.particles.size();
+    const size_t n_vertices = inevt.vertices.size();
+    const int particle_offset = static_cast<int>(frame.particles.size());
+    const int vertex_offset = static_cast<int>(frame.vertices.size());
+
+    event_index_.build(inevt);
+    if (event_index_.getInvalidLinks() > 0) {
+        std::cerr << "Warning: Skipping " << event_index_.getInvalidLinks() << " invalid HepMC3 links" << std::endl;
     }
-    
-    // Copy particles and attach them to their corresponding vertices
+
+    // Copy the particles attached to a vertex with the status offset applied
     long finalParticleCount = 0;
-    for (const auto& particle : inevt.particles()) {
-        HepMC3::FourVector momentum = particle->momentum();
-        int status = particle->status();
-        if (status == 1) finalParticleCount++;
-        int pid = particle->pid();
-        status += baseStatus;
-        auto p1 = std::make_shared<HepMC3::GenParticle>(momentum, pid, status);
-        p1->set_generated_mass(particle->generated_mass());
-        particles.push_back(p1);
-        
-        // Attach particle to production vertex with bounds checking
-        if (particle->production_vertex() && particle->production_vertex()->id() < 0) {
-            int production_vertex = particle->production_vertex()->id();
-            size_t vertex_index = abs(production_vertex) - 1;
-            if (vertex_index < vertices.size()) {
-                vertices[vertex_index]->add_particle_out(p1);
-                hepframe->add_particle(p1);
-            } else {
-                std::cerr << "Warning: Invalid production vertex index " << vertex_index 
-                          << " (vertices size: " << vertices.size() << ")" << std::endl;
-            }
+    particle_index_.assign(n_particles, 0);
+    int next_particle = particle_offset;
+    for (size_t i = 0; i < n_particles; ++i) {
+        const auto& particle = inevt.particles[i];
+        if (particle.status == 1) finalParticleCount++;
+        if (!event_index_.isAttached(i)) continue;
+        particle_index_[i] = ++next_particle;
+        frame.particles.push_back(particle);
+        frame.particles.back().status += baseStatus;
+    }
+
+    // Copy the vertices with explicit, time shifted positions and their links
+    for (size_t v = 0; v < n_vertices; ++v) {
+        frame.vertices.push_back(inevt.vertices[v]);
+        HepMC3::FourVector& position = frame.vertices.back().position;
+        position = event_index_.vertexPosition(v);
+        position.set_t(position.t() + timeHepmc);
+
+        int vertex_id = -(vertex_offset + static_cast<int>(v) + 1);
+        for (int particle : event_index_.incoming(v)) {
+            frame.links1.push_back(particle_index_[particle]);
+            frame.links2.push_back(vertex_id);
         }
-        
-        // Attach particle to end vertex if it has one with bounds checking
-        if (particle->end_vertex()) {
-            int end_vertex = particle->end_vertex()->id();
-            size_t vertex_index = abs(end_vertex) - 1;
-            if (vertex_index < vertices.size()) {
-                vertices[vertex_index]->add_particle_in(p1);
-            } else {
-                std::cerr << "Warning: Invalid end vertex index " << vertex_index 
-                          << " (vertices size: " << vertices.size() << ")" << std::endl;
-            }
+        for (int particle : event_index_.outgoing(v)) {
+            frame.links1.push_back(vertex_id);
+            frame.links2.push_back(particle_index_[particle]);
         }
     }
 
-    // Add all vertices to the merged event
-    for (auto& vertex : vertices) {
-        hepframe->add_vertex(vertex);
-    }
-    
     return finalParticleCount;
 }
 
 void HepMC3DataHandler::writeTimeframe() {
-    if (!current_timeframe_) {
-        throw std::runtime_error("No timeframe to write - prepareTimeframe() not called?");
+    if (!output_tree_) {
+        throw std::runtime_error("No HepMC3 output tree - initializeDataSources() not called?");
     }
     
     // Set event number
-    current_timeframe_->set_event_number(current_timeframe_number_);
+    merged_event_.event_number = static_cast<int>(current_timeframe_number_);
     
     // Write the event
-    writer_->write_event(*current_timeframe_);
-    
-    // Clear the timeframe
-    current_timeframe_.reset();
+    output_tree_->Fill();
 }
 
 void HepMC3DataHandler::finalize() {
-    if (writer_) {
-        writer_->close();
-        writer_.reset();
+    if (output_file_) {
+        output_file_->cd();
+        output_tree_->Write();
+        output_file_->Close();
+        output_file_.reset();
+        output_tree_ = nullptr;
+    }
+    for (auto* source : hepmc3_sources_) {
+        source->printPrefetchStatistics();
     }
+    filter_.printStatistics();
     std::cout << "HepMC3 output finalized" << std::endl;
 }
+
+void HepMC3DataHandler::collectMemoryUsage(MemoryUsage& usage) const {
+    memory_accounting::accountVector(usage, "merged", "hepmc3_event", "particles", merged_event_.particles);
+    memory_accounting::accountVector(usage, "merged", "hepmc3_event", "vertices", merged_event_.vertices);
+    memory_accounting::accountVector(usage, "merged", "hepmc3_event", "links1", merged_event_.links1);
+    memory_accounting::accountVector(usage, "merged", "hepmc3_event", "links2", merged_event_.links2);
+    if (output_tree_) {
+        memory_accounting::accountTree(usage, "output", output_tree_);
+    }
+}
@@ -20,75 +20,240 @@ void HepMC3DataSource::openInputFiles() {
         throw std::runtime_error("No input files specified for source: " + config_->name);
     }
     
-    // For now, support only single file (could be extended to support multiple files)
-    if (config_->input_files.size() > 1) {
-        std::cout << "Warning: HepMC3DataSource currently supports only the first input file. "
-                  << "Using: " << config_->input_files[0] << std::endl;
+    chain_ = std::make_unique<TChain>(kTreeName);
+    for (const auto& input_file : config_->input_files) {
+        // Validate file extension
+        if (input_file.find(".hepmc3.tree.root") == std::string::npos) {
+            throw std::runtime_error(
+                "HepMC3DataSource only supports .hepmc3.tree.root format. Got: " + input_file
+            );
+        }
+        
+        std::cout << "Opening HepMC3 file: " << input_file << std::endl;
+        if (chain_->Add(input_file.c_str()) == 0) {
+            throw std::runtime_error("Failed to open HepMC3 file: " + input_file);
+        }
     }
-    
-    const std::string& input_file = config_->input_files[0];
-    
-    // Validate file extension
-    if (input_file.find(".hepmc3.tree.root") == std::string::npos) {
-        throw std::runtime_error(
-            "HepMC3DataSource only supports .hepmc3.tree.root format. Got: " + input_file
-        );
-    }
-    
-    std::cout << "Opening HepMC3 file: " << input_file << std::endl;
-    
-    // Create ReaderRootTree explicitly for ROOT tree format
-    reader_ = std::make_shared<HepMC3::ReaderRootTree>(input_file);
-    if (!reader_) {
-        throw std::runtime_error("Failed to open HepMC3 file: " + input_file);
+
+    // Bind the same data structures HepMC3::ReaderRootTree uses
+    event_data_ = new HepMC3::GenEventData();
+    run_info_data_ = new HepMC3::GenRunInfoData();
+    chain_->SetBranchAddress(kEventBranchName, &event_data_);
+    if (chain_->GetBranch(kRunInfoBranchName)) {
+        chain_->SetBranchAddress(kRunInfoBranchName, &run_info_data_);
     }
+    run_info_ = std::make_shared<HepMC3::GenRunInfo>();
 
-    // Get entry count directly from TTree
-    total_entries_ = reader_->m_tree->GetEntries();
+    total_entries_ = chain_->GetEntries();
     
-    std::cout << "Found " << total_entries_ << " events in HepMC3 file" << std::endl;
+    std::cout << "Found " << total_entries_ << " events in " << config_->input_files.size()
+              << " HepMC3 file(s)" << std::endl;
+    restrictToEntryPart();
     
     current_entry_index_ = 0;
 }
 
 bool HepMC3DataSource::hasMoreEntries() const {
+    if (config_->repeat_on_eof && total_entries_ > 0) {
+        return true;
+    }
     return current_entry_index_ + entries_needed_ <= total_entries_;
 }
 
 bool HepMC3DataSource::loadNextEvent() {
     if (current_entry_index_ >= total_entries_) {
+        if (config_->repeat_on_eof) {
+            current_entry_index_ = 0;
+        }
         return false;
     }
     
-    if (reader_->failed()) {
-        return false;
-    }
-    
-    // Read the next event
-    if (!reader_->read_event(current_event_)) {
-        return false;
-    }
-    
+    loadEvent(current_entry_index_);
     current_entry_index_++;
     return true;
 }
 
+size_t HepMC3DataSource::wrapEntry(size_t event_index) const {
+    // Wrap around the chain when repeating the input
+    size_t entry = event_index;
+    if (config_->repeat_on_eof && total_entries_ > 0) {
+        entry %= total_entries_;
+    }
+    return entry;
+}
+
 void HepMC3DataSource::loadEvent(size_t event_index) {
-    // HepMC3 readers are sequential, we can't jump to arbitrary positions
-    // This would require reopening and skipping events
-    // For now, just ensure we're reading sequentially
-    if (event_index != current_entry_index_) {
-        std::cerr << "Warning: HepMC3DataSource only supports sequential reading. "
-                  << "Requested event " << event_index << " but at " << current_entry_index_ << std::endl;
+    size_t entry = wrapEntry(event_index);
+    if (entry >= total_entries_) {
+        throw std::runtime_error("HepMC3 source " + config_->name + ": entry " + std::to_string(entry) +
+                                 " out of range (" + std::to_string(total_entries_) + " entries)");
+    }
+
+    if (prefetch_depth_ > 0) {
+        takePrefetched(event_index);
+    } else {
+        readEntry(entry);
+    }
+    current_event_valid_ = false;
+}
+
+void HepMC3DataSource::readEntry(size_t entry) {
+    if (chain_->GetEntry(entry_offset_ + entry) <= 0) {
+        throw std::runtime_error("HepMC3 source " + config_->name + ": failed to read entry " + std::to_string(entry_offset_ + entry));
+    }
+
+    // The run info is the same for all entries of a file, decode it once per file
+    if (chain_->GetTreeNumber() != run_info_tree_number_) {
+        run_info_->read_data(*run_info_data_);
+        run_info_tree_number_ = chain_->GetTreeNumber();
     }
-    loadNextEvent();
+}
+
+void HepMC3DataSource::startPrefetch(size_t depth) {
+    if (depth == 0 || prefetch_depth_ > 0) return;
+    prefetch_depth_ = depth;
+    for (size_t i = 0; i < depth; ++i) {
+        free_buffers_.push_back(new HepMC3::GenEventData());
+    }
+    prefetch_run_info_ = run_info_;
+
+    // The worker reads through prefetch_target_; ROOT picks up the new object
+    // whenever the pointer changes, so each entry lands in its own buffer
+    prefetch_target_ = free_buffers_.front();
+    chain_->SetBranchAddress(kEventBranchName, &prefetch_target_);
+
+    launchPrefetch(current_entry_index_);
+}
+
+void HepMC3DataSource::launchPrefetch(size_t first_index) {
+    stopPrefetch();
+
+    // Recycle entries read ahead for indices that are no longer wanted
+    for (auto& prefetched : ready_) {
+        free_buffers_.push_back(prefetched.data);
+    }
+    ready_.clear();
+    prefetch_next_ = first_index;
+    prefetch_expected_ = first_index;
+    prefetch_stop_ = false;
+    prefetch_done_ = false;
+    prefetch_error_.clear();
+
+    prefetch_thread_ = std::thread(&HepMC3DataSource::prefetchLoop, this);
+}
+
+void HepMC3DataSource::stopPrefetch() {
+    {
+        std::lock_guard<std::mutex> lock(prefetch_mutex_);
+        prefetch_stop_ = true;
+    }
+    prefetch_free_.notify_all();
+    if (prefetch_thread_.joinable()) {
+        prefetch_thread_.join();
+    }
+}
+
+void HepMC3DataSource::takePrefetched(size_t event_index) {
+    if (event_index != prefetch_expected_) {
+        // Out of sequence request: read ahead from the new position
+        launchPrefetch(event_index);
+        ++prefetch_restarts_;
+    }
+
+    std::unique_lock<std::mutex> lock(prefetch_mutex_);
+    if (ready_.empty()) {
+        ++prefetch_waits_;
+        prefetch_ready_.wait(lock, [this] { return !ready_.empty() || prefetch_done_; });
+    } else {
+        ++prefetch_hits_;
+    }
+    if (ready_.empty()) {
+        throw std::runtime_error("HepMC3 source " + config_->name + ": read-ahead stopped before entry " +
+                                 std::to_string(wrapEntry(event_index)) +
+                                 (prefetch_error_.empty() ? "" : " (" + prefetch_error_ + ")"));
+    }
+
+    // Hand the previous event's buffer back to the worker
+    PrefetchedEntry next = ready_.front();
+    ready_.pop_front();
+    free_buffers_.push_back(event_data_);
+    event_data_ = next.data;
+    run_info_ = next.run_info;
+    prefetch_expected_ = event_index + 1;
+    lock.unlock();
+    prefetch_free_.notify_one();
+}
+
+void HepMC3DataSource::prefetchLoop() {
+    while (true) {
+        HepMC3::GenEventData* buffer = nullptr;
+        size_t index = 0;
+        {
+            std::unique_lock<std::mutex> lock(prefetch_mutex_);
+            if (!config_->repeat_on_eof && prefetch_next_ >= total_entries_) {
+                prefetch_done_ = true;
+                break;
+            }
+            prefetch_free_.wait(lock, [this] { return prefetch_stop_ || !free_buffers_.empty(); });
+            if (prefetch_stop_) return;
+            buffer = free_buffers_.back();
+            free_buffers_.pop_back();
+            index = prefetch_next_++;
+        }
+
+        // Read outside the lock; the merge thread only touches buffers in ready_
+        std::string error;
+        size_t entry = wrapEntry(index);
+        prefetch_target_ = buffer;
+        if (chain_->GetEntry(entry_offset_ + entry) <= 0) {
+            error = "failed to read entry " + std::to_string(entry_offset_ + entry);
+        } else if (chain_->GetTreeNumber() != run_info_tree_number_) {
+            // Entries still queued from the previous file keep their run info
+            prefetch_run_info_ = std::make_shared<HepMC3::GenRunInfo>();
+            prefetch_run_info_->read_data(*run_info_data_);
+            run_info_tree_number_ = chain_->GetTreeNumber();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(prefetch_mutex_);
+            if (error.empty()) {
+                ready_.push_back({index, buffer, prefetch_run_info_});
+            } else {
+                free_buffers_.push_back(buffer);
+                prefetch_error_ = error;
+                prefetch_done_ = true;
+            }
+        }
+        prefetch_ready_.notify_one();
+        if (!error.empty()) return;
+    }
+    prefetch_ready_.notify_one();
+}
+
+const HepMC3::GenEvent& HepMC3DataSource::getCurrentEvent() const {
+    if (!current_event_valid_ && event_data_) {
+        current_event_.read_data(*event_data_);
+        current_event_.set_run_info(run_info_);
+        current_event_valid_ = true;
+    }
+    return current_event_;
 }
 
 void HepMC3DataSource::cleanup() {
-    if (reader_) {
-        reader_->close();
-        reader_.reset();
+    stopPrefetch();
+    chain_.reset();
+    for (auto& prefetched : ready_) {
+        delete prefetched.data;
     }
+    ready_.clear();
+    for (auto* buffer : free_buffers_) {
+        delete buffer;
+    }
+    free_buffers_.clear();
+    delete event_data_;
+    delete run_info_data_;
+    event_data_ = nullptr;
+    run_info_data_ = nullptr;
 }
 
 void HepMC3DataSource::printStatus() const {
@@ -99,15 +264,56 @@ void HepMC3DataSource::printStatus() const {
     std::cout << "  Current Entry: " << current_entry_index_ << std::endl;
     std::cout << "  Entries Needed: " << entries_needed_ << std::endl;
     std::cout << "  Current Time Offset: " << current_time_offset_ << std::endl;
+    if (prefetch_depth_ > 0) {
+        std::cout << "  Prefetch Depth: " << prefetch_depth_ << std::endl;
+    }
+}
+
+void HepMC3DataSource::printPrefetchStatistics() const {
+    if (prefetch_depth_ == 0) return;
+    std::cout << "Prefetch " << config_->name << ": depth " << prefetch_depth_ << ", "
+              << prefetch_hits_ << " entries ready, " << prefetch_waits_ << " waited for";
+    if (prefetch_restarts_ > 0) {
+        std::cout << ", " << prefetch_restarts_ << " restarts";
+    }
+    std::cout << std::endl;
+}
+
+void HepMC3DataSource::collectMemoryUsage(MemoryUsage& usage) const {
+    if (event_data_) {
+        memory_accounting::accountVector(usage, config_->name, "hepmc3_event", "particles", event_data_->particles);
+        memory_accounting::accountVector(usage, config_->name, "hepmc3_event", "vertices", event_data_->vertices);
+        memory_accounting::accountVector(usage, config_->name, "hepmc3_event", "links1", event_data_->links1);
+        memory_accounting::accountVector(usage, config_->name, "hepmc3_event", "links2", event_data_->links2);
+    }
+    if (prefetch_depth_ > 0) {
+        // The worker owns the chain while prefetching, only the queued buffers are accounted
+        std::lock_guard<std::mutex> lock(prefetch_mutex_);
+        MemoryUsageEntry queued{config_->name, "prefetch", "queued_events", 0, 0};
+        auto add = [&queued](const HepMC3::GenEventData& data) {
+            queued.size_bytes += data.particles.size() * sizeof(HepMC3::GenParticleData)
+                               + data.vertices.size() * sizeof(HepMC3::GenVertexData)
+                               + (data.links1.size() + data.links2.size()) * sizeof(int);
+            queued.capacity_bytes += data.particles.capacity() * sizeof(HepMC3::GenParticleData)
+                                   + data.vertices.capacity() * sizeof(HepMC3::GenVertexData)
+                                   + (data.links1.capacity() + data.links2.capacity()) * sizeof(int);
+        };
+        for (const auto& prefetched : ready_) add(*prefetched.data);
+        for (const auto* buffer : free_buffers_) add(*buffer);
+        usage.push_back(queued);
+    } else if (chain_) {
+        memory_accounting::accountTree(usage, config_->name, chain_.get());
+    }
 }
 
 DataSource::VertexPosition HepMC3DataSource::getBeamVertexPosition() const {
     VertexPosition pos{0.0f, 0.0f, 0.0f};
     
-    // Get the first vertex in the event (production vertex)
-    const auto& vertices = current_event_.vertices();
-    if (!vertices.empty() && vertices[0]) {
-        const auto& vertex_pos = vertices[0]->position();
+    // Get the first vertex in the event (production vertex); an unset position
+    // is inherited from the event position, as in HepMC3::GenVertex::position()
+    if (event_data_ && !event_data_->vertices.empty()) {
+        const auto& vertex_pos = event_data_->vertices[0].position.is_zero()
+            ? event_data_->event_pos : event_data_->vertices[0].position;
         pos.x = static_cast<float>(vertex_pos.x());
         pos.y = static_cast<float>(vertex_pos.y());
         pos.z = static_cast<float>(vertex_pos.z());
@@ -0,0 +1,122 @@
+#include "HepMC3EventFilter.h"
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+bool samePosition(const HepMC3::FourVector& a, const HepMC3::FourVector& b) {
+    return a.x() == b.x() && a.y() == b.y() && a.z() == b.z() && a.t() == b.t();
+}
+
+} // namespace
+
+bool HepMC3EventFilter::enabled(const SourceConfig& config) {
+    return config.final_state_only || config.collapse_history ||
+           config.min_momentum > 0.0f || config.max_abs_eta > 0.0f;
+}
+
+bool HepMC3EventFilter::acceptParticle(const HepMC3::GenParticleData& particle, const SourceConfig& config,
+                                       double momentum_scale) const {
+    // Beam particles are always kept, the acceptance only applies to the final state
+    if (particle.status == 4) return true;
+    if (particle.status != 1) return !(config.final_state_only || config.collapse_history);
+    if (config.min_momentum > 0.0f && particle.momentum.p3mod() * momentum_scale < config.min_momentum) {
+        return false;
+    }
+    if (config.max_abs_eta > 0.0f && std::abs(particle.momentum.eta()) > config.max_abs_eta) {
+        return false;
+    }
+    return true;
+}
+
+const HepMC3::GenEventData& HepMC3EventFilter::apply(const HepMC3::GenEventData& event, const SourceConfig& config) {
+    event_index_.build(event);
+    const double momentum_scale = event.momentum_unit == HepMC3::Units::MEV ? 1e-3 : 1.0;
+
+    filtered_.event_number = event.event_number;
+    filtered_.momentum_unit = event.momentum_unit;
+    filtered_.length_unit = event.length_unit;
+    filtered_.event_pos = event.event_pos;
+    filtered_.weights = event.weights;
+    filtered_.particles.clear();
+    filtered_.vertices.clear();
+    filtered_.links1.clear();
+    filtered_.links2.clear();
+    filtered_.attribute_id.clear();
+    filtered_.attribute_name.clear();
+    filtered_.attribute_string.clear();
+
+    // Kept particles get consecutive 1-based ids
+    particle_index_.assign(event.particles.size(), 0);
+    for (size_t i = 0; i < event.particles.size(); ++i) {
+        if (acceptParticle(event.particles[i], config, momentum_scale)) {
+            filtered_.particles.push_back(event.particles[i]);
+            particle_index_[i] = static_cast<int>(filtered_.particles.size());
+        }
+    }
+
+    // Keep the vertices that still have particles, with explicit positions
+    const bool collapse = config.collapse_history;
+    vertex_index_.assign(event.vertices.size(), 0);
+    for (size_t v = 0; v < event.vertices.size(); ++v) {
+        auto particles_in = event_index_.incoming(v);
+        auto particles_out = event_index_.outgoing(v);
+        bool used = false;
+        for (int particle : particles_in) used = used || particle_index_[particle] > 0;
+        for (int particle : particles_out) used = used || particle_index_[particle] > 0;
+        if (!used) continue;
+
+        const HepMC3::FourVector& position = event_index_.vertexPosition(v);
+        if (collapse) {
+            // Few distinct production points remain once the history is gone
+            for (size_t k = 0; k < filtered_.vertices.size(); ++k) {
+                if (samePosition(filtered_.vertices[k].position, position)) {
+                    vertex_index_[v] = static_cast<int>(k + 1);
+                    break;
+                }
+            }
+        }
+        if (vertex_index_[v] == 0) {
+            filtered_.vertices.push_back(event.vertices[v]);
+            filtered_.vertices.back().position = position;
+            vertex_index_[v] = static_cast<int>(filtered_.vertices.size());
+        }
+
+        int vertex_id = -vertex_index_[v];
+        for (int particle : particles_in) {
+            if (particle_index_[particle] == 0) continue;
+            filtered_.links1.push_back(particle_index_[particle]);
+            filtered_.links2.push_back(vertex_id);
+        }
+        for (int particle : particles_out) {
+            if (particle_index_[particle] == 0) continue;
+            filtered_.links1.push_back(vertex_id);
+            filtered_.links2.push_back(particle_index_[particle]);
+        }
+    }
+
+    auto [it, inserted] = statistics_.try_emplace(config.name);
+    if (inserted) {
+        source_names_.push_back(config.name);
+    }
+    Statistics& statistics = it->second;
+    statistics.events++;
+    statistics.particles_in += event.particles.size();
+    statistics.particles_out += filtered_.particles.size();
+    statistics.vertices_in += event.vertices.size();
+    statistics.vertices_out += filtered_.vertices.size();
+
+    return filtered_;
+}
+
+void HepMC3EventFilter::printStatistics() const {
+    for (const auto& name : source_names_) {
+        const auto& statistics = statistics_.at(name);
+        double particle_fraction = statistics.particles_in > 0
+            ? 100.0 * statistics.particles_out / statistics.particles_in : 0.0;
+        std::cout << "HepMC3 filter " << name << ": kept " << statistics.particles_out << " of "
+                  << statistics.particles_in << " particles (" << particle_fraction << "%) and "
+                  << statistics.vertices_out << " of " << statistics.vertices_in << " vertices in "
+                  << statistics.events << " events" << std::endl;
+    }
+}
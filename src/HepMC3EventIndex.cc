@@ -0,0 +1,91 @@
+#include "HepMC3EventIndex.h"
+#include <algorithm>
+
+void HepMC3EventIndex::build(const HepMC3::GenEventData& event) {
+    event_ = &event;
+    const size_t n_particles = event.particles.size();
+    const size_t n_vertices = event.vertices.size();
+    const size_t n_links = std::min(event.links1.size(), event.links2.size());
+
+    production_vertex_.assign(n_particles, -1);
+    end_vertex_.assign(n_particles, -1);
+    incoming_begin_.assign(n_vertices + 1, 0);
+    outgoing_begin_.assign(n_vertices + 1, 0);
+    invalid_links_ = 0;
+
+    // A link is (particle, end vertex) or (production vertex, particle); ids are
+    // 1-based, positive for particles and negative for vertices
+    auto decode = [&](size_t k, size_t& particle, size_t& vertex) {
+        int first = event.links1[k];
+        int second = event.links2[k];
+        int particle_id = first > 0 ? first : second;
+        int vertex_id = first > 0 ? second : first;
+        if (particle_id <= 0 || vertex_id >= 0 ||
+            static_cast<size_t>(particle_id) > n_particles || static_cast<size_t>(-vertex_id) > n_vertices) {
+            return false;
+        }
+        particle = particle_id - 1;
+        vertex = -vertex_id - 1;
+        return true;
+    };
+
+    // Count incoming and outgoing particles per vertex
+    for (size_t k = 0; k < n_links; ++k) {
+        size_t particle, vertex;
+        if (!decode(k, particle, vertex)) {
+            ++invalid_links_;
+            continue;
+        }
+        if (event.links1[k] > 0) {
+            ++incoming_begin_[vertex + 1];
+            end_vertex_[particle] = static_cast<int>(vertex);
+        } else {
+            ++outgoing_begin_[vertex + 1];
+            production_vertex_[particle] = static_cast<int>(vertex);
+        }
+    }
+    for (size_t v = 0; v < n_vertices; ++v) {
+        incoming_begin_[v + 1] += incoming_begin_[v];
+        outgoing_begin_[v + 1] += outgoing_begin_[v];
+    }
+
+    // Fill in link order
+    incoming_.resize(incoming_begin_[n_vertices]);
+    outgoing_.resize(outgoing_begin_[n_vertices]);
+    incoming_scratch_.assign(incoming_begin_.begin(), incoming_begin_.end() - 1);
+    outgoing_scratch_.assign(outgoing_begin_.begin(), outgoing_begin_.end() - 1);
+    for (size_t k = 0; k < n_links; ++k) {
+        size_t particle, vertex;
+        if (!decode(k, particle, vertex)) continue;
+        if (event.links1[k] > 0) {
+            incoming_[incoming_scratch_[vertex]++] = static_cast<int>(particle);
+        } else {
+            outgoing_[outgoing_scratch_[vertex]++] = static_cast<int>(particle);
+        }
+    }
+
+    vertex_position_.resize(n_vertices);
+    vertex_state_.assign(n_vertices, 0);
+}
+
+const HepMC3::FourVector& HepMC3EventIndex::vertexPosition(size_t vertex) {
+    if (vertex_state_[vertex] == 2) return vertex_position_[vertex];
+
+    const HepMC3::FourVector& position = event_->vertices[vertex].position;
+    vertex_position_[vertex] = position;
+    if (position.is_zero()) {
+        // Inherit from the production vertex of the first incoming particle, or the event position
+        vertex_position_[vertex] = event_->event_pos;
+        vertex_state_[vertex] = 1;
+        auto particles_in = incoming(vertex);
+        if (!particles_in.empty()) {
+            int parent = production_vertex_[particles_in.front()];
+            // A cycle falls back to the event position
+            if (parent >= 0 && vertex_state_[parent] != 1) {
+                vertex_position_[vertex] = vertexPosition(parent);
+            }
+        }
+    }
+    vertex_state_[vertex] = 2;
+    return vertex_position_[vertex];
+}
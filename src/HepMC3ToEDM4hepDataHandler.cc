@@ -0,0 +1,215 @@
+#include "HepMC3ToEDM4hepDataHandler.h"
+#include "HepMC3DataHandler.h"
+#include <edm4hep/EventHeaderCollection.h>
+#include <edm4hep/MCParticleCollection.h>
+#include <podio/DatamodelRegistry.h>
+#include <podio/podioVersion.h>
+#include <podio/utilities/RootHelpers.h>
+#include <TDatabasePDG.h>
+#include <iostream>
+#include <stdexcept>
+#include <tuple>
+
+std::vector<std::unique_ptr<DataSource>> HepMC3ToEDM4hepDataHandler::initializeDataSources(
+    const std::string& filename,
+    const std::vector<SourceConfig>& source_configs) {
+
+    std::cout << "Initializing HepMC3 to EDM4hep data handler for: " << filename << std::endl;
+
+    auto data_sources = HepMC3DataHandler::createSources(
+        source_configs, config_ ? config_->timeframe_duration : MergerConfig{}.timeframe_duration, hepmc3_sources_);
+
+    // Open output file
+    output_file_ = std::make_unique<TFile>(filename.c_str(), "RECREATE");
+    if (!output_file_ || output_file_->IsZombie()) {
+        throw std::runtime_error("Could not create output file: " + filename);
+    }
+    output_file_->SetCompressionSettings(getCompressionSettings());
+
+    // Same layout as EDM4hepDataHandler, without hit collections
+    output_tree_ = new TTree("events", "Merged timeframes");
+    collections_.setupBranches(output_tree_, {}, {}, {});
+
+    id_table_.add("EventHeader");
+    id_table_.add("SubEventHeaders");
+    mcparticles_collection_id_ = id_table_.add("MCParticles");
+
+    std::cout << "HepMC3 to EDM4hep data handler initialized with " << hepmc3_sources_.size() << " sources" << std::endl;
+
+    return data_sources;
+}
+
+void HepMC3ToEDM4hepDataHandler::prepareTimeframe() {
+    collections_.clear();
+}
+
+void HepMC3ToEDM4hepDataHandler::processEvent(HepMC3DataSource& source) {
+    const auto& config = source.getConfig();
+    double time_offset_ns = source.getCurrentTimeOffset();
+
+    // SubEventHeader tracking which MCParticles came from this source, as in EDM4hepDataHandler
+    edm4hep::EventHeaderData sub_header;
+    sub_header.eventNumber = sub_events_consumed_;
+    sub_header.runNumber = source.getSourceIndex();
+    sub_header.timeStamp = collections_.mcparticles.size();
+    sub_header.weight = time_offset_ns;
+    collections_.sub_event_headers.push_back(sub_header);
+    collections_.sub_event_header_weights.push_back(sub_header.weight);
+
+    const auto& data = source.getCurrentEventData();
+    const auto& event = HepMC3EventFilter::enabled(config) ? filter_.apply(data, config) : data;
+    appendMCParticles(event, time_offset_ns, config.generator_status_offset);
+
+    sub_events_consumed_++;
+}
+
+void HepMC3ToEDM4hepDataHandler::appendMCParticles(const HepMC3::GenEventData& event, double time, int baseStatus) {
+    event_index_.build(event);
+    if (event_index_.getInvalidLinks() > 0) {
+        std::cerr << "Warning: Skipping " << event_index_.getInvalidLinks() << " invalid HepMC3 links" << std::endl;
+    }
+
+    // EDM4hep uses GeV and mm
+    const double momentum_scale = event.momentum_unit == HepMC3::Units::MEV ? 1e-3 : 1.0;
+    const double length_scale = event.length_unit == HepMC3::Units::CM ? 10.0 : 1.0;
+
+    auto& particles = collections_.mcparticles;
+    auto& parents = collections_.mcparticle_parents_refs;
+    auto& daughters = collections_.mcparticle_daughters_refs;
+    const int particle_offset = static_cast<int>(particles.size());
+
+    for (size_t i = 0; i < event.particles.size(); ++i) {
+        const auto& in = event.particles[i];
+        edm4hep::MCParticleData particle;
+        particle.PDG = in.pid;
+        particle.generatorStatus = in.status + baseStatus;
+        particle.charge = chargeOf(in.pid);
+        particle.mass = (in.is_mass_set ? in.mass : in.momentum.m()) * momentum_scale;
+        particle.momentum.x = in.momentum.px() * momentum_scale;
+        particle.momentum.y = in.momentum.py() * momentum_scale;
+        particle.momentum.z = in.momentum.pz() * momentum_scale;
+        particle.time = static_cast<float>(time);
+
+        // Vertex and time from the production vertex, parents are the particles entering it
+        particle.parents_begin = parents.size();
+        int production_vertex = event_index_.productionVertex(i);
+        if (production_vertex >= 0) {
+            const auto& position = event_index_.vertexPosition(production_vertex);
+            particle.vertex.x = position.x() * length_scale;
+            particle.vertex.y = position.y() * length_scale;
+            particle.vertex.z = position.z() * length_scale;
+            particle.time = static_cast<float>(position.t() * length_scale / c_light + time);
+            for (int parent : event_index_.incoming(production_vertex)) {
+                parents.push_back({particle_offset + parent, mcparticles_collection_id_});
+            }
+        }
+        particle.parents_end = parents.size();
+
+        // Endpoint from the end vertex, daughters are the particles leaving it
+        particle.daughters_begin = daughters.size();
+        int end_vertex = event_index_.endVertex(i);
+        if (end_vertex >= 0) {
+            const auto& position = event_index_.vertexPosition(end_vertex);
+            particle.endpoint.x = position.x() * length_scale;
+            particle.endpoint.y = position.y() * length_scale;
+            particle.endpoint.z = position.z() * length_scale;
+            for (int daughter : event_index_.outgoing(end_vertex)) {
+                daughters.push_back({particle_offset + daughter, mcparticles_collection_id_});
+            }
+        }
+        particle.daughters_end = daughters.size();
+
+        particles.push_back(particle);
+    }
+}
+
+float HepMC3ToEDM4hepDataHandler::chargeOf(int pdg) {
+    auto it = charges_.find(pdg);
+    if (it != charges_.end()) {
+        return it->second;
+    }
+    // TParticlePDG::Charge is in units of |e|/3; unknown codes (nuclei, generator specific) get 0
+    float charge = 0.0f;
+    if (TParticlePDG* pdg_particle = TDatabasePDG::Instance()->GetParticle(pdg)) {
+        charge = static_cast<float>(pdg_particle->Charge() / 3.0);
+    }
+    charges_.emplace(pdg, charge);
+    return charge;
+}
+
+void HepMC3ToEDM4hepDataHandler::writeTimeframe() {
+    if (!output_tree_) {
+        throw std::runtime_error("Output tree not initialized");
+    }
+
+    // Create main timeframe header
+    edm4hep::EventHeaderData header;
+    header.eventNumber = current_timeframe_number_;
+    header.runNumber = 0;
+    header.timeStamp = current_timeframe_number_;
+    collections_.event_headers.push_back(header);
+
+    output_tree_->Fill();
+}
+
+void HepMC3ToEDM4hepDataHandler::finalize() {
+    if (output_file_) {
+        output_file_->cd();
+        if (output_tree_) {
+            output_tree_->Write();
+        }
+        writePodioMetadata();
+        output_file_->Close();
+        output_file_.reset();
+        output_tree_ = nullptr;
+    }
+    for (auto* source : hepmc3_sources_) {
+        source->printPrefetchStatistics();
+    }
+    filter_.printStatistics();
+    std::cout << "HepMC3 to EDM4hep output finalized" << std::endl;
+}
+
+void HepMC3ToEDM4hepDataHandler::writePodioMetadata() {
+    // Minimal version of what podio::ROOTWriter writes: collection IDs and types of
+    // the events category, the podio build version and the EDM4hep definition
+    auto* metadata_tree = new TTree("podio_metadata", "metadata tree for podio I/O functionality");
+    metadata_tree->SetDirectory(output_file_.get());
+
+    std::vector<podio::root_utils::CollectionWriteInfo> collection_info;
+    auto addCollection = [&](const std::string& name, std::string_view type, std::string_view data_type,
+                             unsigned int schema_version) {
+        podio::root_utils::CollectionWriteInfo info;
+        info.collectionID = id_table_.collectionID(name).value();
+        info.dataType = std::string(type);
+        info.isSubset = false;
+        info.schemaVersion = schema_version;
+        info.name = name;
+        info.storageType = "std::vector<" + std::string(data_type) + ">";
+        collection_info.push_back(info);
+    };
+    addCollection("EventHeader", edm4hep::EventHeaderCollection::typeName,
+                  edm4hep::EventHeaderCollection::dataTypeName, edm4hep::EventHeaderCollection::schemaVersion);
+    addCollection("SubEventHeaders", edm4hep::EventHeaderCollection::typeName,
+                  edm4hep::EventHeaderCollection::dataTypeName, edm4hep::EventHeaderCollection::schemaVersion);
+    addCollection("MCParticles", edm4hep::MCParticleCollection::typeName,
+                  edm4hep::MCParticleCollection::dataTypeName, edm4hep::MCParticleCollection::schemaVersion);
+
+    auto podio_version = podio::version::build_version;
+    std::vector<std::tuple<std::string, std::string>> edm_definitions{
+        {"edm4hep", std::string(podio::DatamodelRegistry::instance().getDatamodelDefinition("edm4hep"))}};
+
+    metadata_tree->Branch("events___idTable", &id_table_);
+    metadata_tree->Branch("events___CollectionTypeInfo", &collection_info);
+    metadata_tree->Branch("PodioBuildVersion", &podio_version);
+    metadata_tree->Branch("EDMDefinitions", &edm_definitions);
+    metadata_tree->Fill();
+    metadata_tree->Write();
+}
+
+void HepMC3ToEDM4hepDataHandler::collectMemoryUsage(MemoryUsage& usage) const {
+    collections_.collectMemoryUsage(usage);
+    if (output_tree_) {
+        memory_accounting::accountTree(usage, "output", output_tree_);
+    }
+}
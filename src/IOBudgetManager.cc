@@ -0,0 +1,193 @@
+#include "IOBudgetManager.h"
+
+#include <TChain.h>
+#include <TFile.h>
+#include <TTreeCache.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// Smallest cache worth creating: a few baskets of a typical EDM4hep tree
+constexpr size_t kMinCacheBytes = 1024 * 1024;
+
+// Only resize a cache when the new size differs by more than this fraction,
+// since SetCacheSize drops the cached baskets
+constexpr double kResizeThreshold = 0.1;
+
+double toMB(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+IOBudgetManager::IOBudgetManager(size_t budget_bytes, size_t rebalance_interval)
+    : budget_bytes_(budget_bytes), rebalance_interval_(rebalance_interval) {}
+
+void IOBudgetManager::addChain(TChain* chain, const std::string& name, double entries_per_timeframe) {
+    for (auto& budget : chains_) {
+        if (budget.chain == chain) {
+            budget.entries_per_timeframe += entries_per_timeframe;
+            budget.name += "+" + name;
+            return;
+        }
+    }
+
+    ChainBudget budget;
+    budget.chain = chain;
+    budget.name = name;
+    budget.entries_per_timeframe = entries_per_timeframe;
+
+    // Compressed size of the first tree is representative for the chain
+    chain->LoadTree(0);
+    TTree* tree = chain->GetTree();
+    if (tree && tree->GetEntries() > 0) {
+        budget.max_bytes = static_cast<size_t>(tree->GetZipBytes());
+        budget.bytes_per_entry = static_cast<double>(tree->GetZipBytes()) / tree->GetEntries();
+    }
+    chains_.push_back(budget);
+}
+
+void IOBudgetManager::addReaderChain(TChain* chain, TChain* reader_chain) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& budget : chains_) {
+        if (budget.chain != chain) continue;
+        budget.readers.push_back({reader_chain, {}});
+        // The chains already reading keep their cache until the next endTimeframe
+        reader_chain->SetCacheSize(static_cast<long long>(budget.cache_bytes / (budget.readers.size() + 1)));
+        resplit_pending_ = true;
+        return;
+    }
+}
+
+void IOBudgetManager::allocate() {
+    for (auto& budget : chains_) {
+        budget.weight = budget.entries_per_timeframe * budget.bytes_per_entry;
+    }
+    distribute();
+    printAllocation();
+}
+
+void IOBudgetManager::distribute() {
+    if (chains_.empty()) return;
+
+    // Water filling: chains that would get more than their tree size are capped
+    // and the remainder is shared by the others in proportion to their weights
+    std::vector<size_t> shares(chains_.size(), 0);
+    std::vector<bool> capped(chains_.size(), false);
+    size_t remaining = budget_bytes_;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        double total_weight = 0.0;
+        for (size_t i = 0; i < chains_.size(); ++i) {
+            if (!capped[i]) total_weight += chains_[i].weight;
+        }
+        for (size_t i = 0; i < chains_.size(); ++i) {
+            if (capped[i]) continue;
+            double fraction = total_weight > 0.0 ? chains_[i].weight / total_weight : 0.0;
+            shares[i] = static_cast<size_t>(fraction * remaining);
+            if (chains_[i].max_bytes > 0 && shares[i] > chains_[i].max_bytes) {
+                shares[i] = chains_[i].max_bytes;
+                capped[i] = true;
+                remaining -= std::min(remaining, shares[i]);
+                changed = true;
+            }
+        }
+    }
+
+    size_t min_bytes = std::min(kMinCacheBytes, budget_bytes_ / chains_.size());
+    for (size_t i = 0; i < chains_.size(); ++i) {
+        apply(chains_[i], std::max(shares[i], min_bytes));
+    }
+}
+
+void IOBudgetManager::apply(ChainBudget& budget, size_t cache_bytes, bool force) {
+    double change = budget.cache_bytes > 0
+        ? std::abs(static_cast<double>(cache_bytes) - budget.cache_bytes) / budget.cache_bytes
+        : 1.0;
+    if (!force && change <= kResizeThreshold) return;
+
+    // The share is split evenly between the chain and its readers
+    const auto share = static_cast<long long>(cache_bytes / (budget.readers.size() + 1));
+    budget.chain->SetCacheSize(share);
+    for (auto& [reader_chain, position] : budget.readers) {
+        reader_chain->SetCacheSize(share);
+    }
+    budget.cache_bytes = cache_bytes;
+}
+
+void IOBudgetManager::endTimeframe() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (resplit_pending_) {
+        for (auto& budget : chains_) {
+            if (!budget.readers.empty()) {
+                apply(budget, budget.cache_bytes, true);
+            }
+        }
+        resplit_pending_ = false;
+    }
+    if (rebalance_interval_ == 0) return;
+    if (++timeframes_since_rebalance_ < rebalance_interval_) return;
+    timeframes_since_rebalance_ = 0;
+    rebalance();
+}
+
+long long IOBudgetManager::bytesReadSince(TChain* chain, ReadPosition& position) {
+    TFile* file = chain->GetCurrentFile();
+    if (!file) return 0;
+
+    // The counter restarts when the chain moves to a new file
+    long long bytes_read = file->GetBytesRead();
+    long long delta = bytes_read;
+    if (position.last_file == file->GetName() && bytes_read >= position.last_bytes_read) {
+        delta = bytes_read - position.last_bytes_read;
+    }
+    position.last_bytes_read = bytes_read;
+    position.last_file = file->GetName();
+    return delta;
+}
+
+void IOBudgetManager::rebalance() {
+    for (auto& budget : chains_) {
+        TFile* file = budget.chain->GetCurrentFile();
+        if (!file) continue;
+
+        // Bytes read since the last rebalance, by the chain and its readers
+        long long delta = bytesReadSince(budget.chain, budget.position);
+        for (auto& [reader_chain, position] : budget.readers) {
+            delta += bytesReadSince(reader_chain, position);
+        }
+
+        // Chains missing the cache more need a larger share for the same volume
+        double miss_rate = 1.0;
+        auto* cache = dynamic_cast<TTreeCache*>(file->GetCacheRead(budget.chain->GetTree()));
+        if (cache && cache->GetNReadOk() + cache->GetNReadMiss() > 0) {
+            miss_rate = static_cast<double>(cache->GetNReadMiss()) / (cache->GetNReadOk() + cache->GetNReadMiss());
+        }
+
+        // Blend the observed demand with the previous weight to avoid oscillations
+        double observed = static_cast<double>(delta) / rebalance_interval_ * (1.0 + miss_rate);
+        budget.weight = 0.5 * budget.weight + 0.5 * observed;
+    }
+    distribute();
+    ++n_rebalances_;
+}
+
+void IOBudgetManager::printAllocation() const {
+    std::cout << "I/O memory budget: " << toMB(budget_bytes_) << " MB over " << chains_.size() << " chains";
+    if (rebalance_interval_ > 0) {
+        std::cout << " (rebalanced every " << rebalance_interval_ << " timeframes, " << n_rebalances_ << " so far)";
+    }
+    std::cout << std::endl;
+    for (const auto& budget : chains_) {
+        std::cout << "  " << budget.name << ": " << toMB(budget.cache_bytes) << " MB cache ("
+                  << budget.entries_per_timeframe << " entries/timeframe, "
+                  << budget.bytes_per_entry / 1024.0 << " kB/entry";
+        if (!budget.readers.empty()) {
+            std::cout << ", split over " << budget.readers.size() + 1 << " readers";
+        }
+        std::cout << ")" << std::endl;
+    }
+}
@@ -0,0 +1,208 @@
+#include "MemoryAccounting.h"
+
+#include <TTree.h>
+#include <TBranch.h>
+#include <TBasket.h>
+#include <TFile.h>
+#include <TFileCacheRead.h>
+#include <TObjArray.h>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// Sum the in-memory basket buffers of a branch and all of its sub-branches
+size_t branchBasketBytes(TBranch* branch) {
+    size_t bytes = 0;
+    TObjArray* baskets = branch->GetListOfBaskets();
+    if (baskets) {
+        for (Int_t i = 0; i < baskets->GetEntriesFast(); ++i) {
+            auto* basket = static_cast<TBasket*>(baskets->UncheckedAt(i));
+            if (basket) {
+                bytes += basket->GetBufferSize();
+            }
+        }
+    }
+    TObjArray* sub_branches = branch->GetListOfBranches();
+    if (sub_branches) {
+        for (Int_t i = 0; i < sub_branches->GetEntriesFast(); ++i) {
+            auto* sub_branch = static_cast<TBranch*>(sub_branches->UncheckedAt(i));
+            if (sub_branch) {
+                bytes += branchBasketBytes(sub_branch);
+            }
+        }
+    }
+    return bytes;
+}
+
+double toMB(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+size_t totalCapacity(const MemoryUsage& usage) {
+    size_t total = 0;
+    for (const auto& entry : usage) {
+        total += entry.capacity_bytes;
+    }
+    return total;
+}
+
+// Aggregate (size, capacity) per owner and category
+std::map<std::pair<std::string, std::string>, std::pair<size_t, size_t>> aggregate(const MemoryUsage& usage) {
+    std::map<std::pair<std::string, std::string>, std::pair<size_t, size_t>> totals;
+    for (const auto& entry : usage) {
+        auto& total = totals[{entry.owner, entry.category}];
+        total.first += entry.size_bytes;
+        total.second += entry.capacity_bytes;
+    }
+    return totals;
+}
+
+constexpr size_t kLargestBuffers = 20;
+
+} // namespace
+
+namespace memory_accounting {
+
+void accountTree(MemoryUsage& usage, const std::string& owner, TTree* tree) {
+    if (!tree) return;
+
+    // For a TChain the baskets live in the tree of the current file
+    TTree* current_tree = tree->GetTree();
+    if (!current_tree) return;
+
+    TObjArray* branches = current_tree->GetListOfBranches();
+    for (Int_t i = 0; branches && i < branches->GetEntriesFast(); ++i) {
+        auto* branch = static_cast<TBranch*>(branches->UncheckedAt(i));
+        if (!branch) continue;
+        size_t bytes = branchBasketBytes(branch);
+        if (bytes > 0) {
+            usage.push_back({owner, "ttree_baskets", branch->GetName(), bytes, bytes});
+        }
+    }
+
+    TFile* file = current_tree->GetCurrentFile();
+    if (file) {
+        TFileCacheRead* cache = file->GetCacheRead(current_tree);
+        if (cache) {
+            size_t bytes = cache->GetBufferSize();
+            usage.push_back({owner, "ttree_cache", current_tree->GetName(), bytes, bytes});
+        }
+    }
+}
+
+size_t currentRSSBytes() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmRSS:", 0) == 0) {
+            // Format: "VmRSS:    123456 kB"
+            return std::stoull(line.substr(6)) * 1024;
+        }
+    }
+    return 0;
+}
+
+std::string jsonEscape(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\b': escaped += "\\b"; break;
+            case '\f': escaped += "\\f"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    // Remaining control characters as \u00XX
+                    char code[7];
+                    std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
+} // namespace memory_accounting
+
+void MemoryAccountant::openTimeSeries(const std::string& filename) {
+    timeseries_.open(filename);
+    if (!timeseries_) {
+        throw std::runtime_error("Could not open memory time series file: " + filename);
+    }
+    timeseries_ << "timeframe,rss_bytes,owner,category,size_bytes,capacity_bytes\n";
+}
+
+void MemoryAccountant::record(size_t timeframe, MemoryUsage usage) {
+    size_t rss = memory_accounting::currentRSSBytes();
+    size_t capacity = totalCapacity(usage);
+
+    if (timeseries_.is_open()) {
+        for (const auto& [key, total] : aggregate(usage)) {
+            timeseries_ << timeframe << "," << rss << "," << key.first << "," << key.second << ","
+                        << total.first << "," << total.second << "\n";
+        }
+    }
+
+    std::cout << "Memory: timeframe " << timeframe << " accounted " << toMB(capacity)
+              << " MB (capacity), RSS " << toMB(rss) << " MB" << std::endl;
+
+    if (capacity >= peak_capacity_bytes_) {
+        peak_capacity_bytes_ = capacity;
+        peak_timeframe_ = timeframe;
+        peak_rss_bytes_ = rss;
+        peak_usage_ = std::move(usage);
+    }
+}
+
+void MemoryAccountant::printSummary() const {
+    std::cout << "\nMemory accounting at peak (timeframe " << peak_timeframe_ << "):" << std::endl;
+    std::cout << "  Accounted capacity: " << toMB(peak_capacity_bytes_) << " MB" << std::endl;
+    std::cout << "  RSS: " << toMB(peak_rss_bytes_) << " MB" << std::endl;
+    for (const auto& [key, total] : aggregate(peak_usage_)) {
+        std::cout << "    " << key.first << " / " << key.second << ": " << toMB(total.first)
+                  << " MB used, " << toMB(total.second) << " MB capacity" << std::endl;
+    }
+
+    MemoryUsage largest = peak_usage_;
+    size_t n = std::min(kLargestBuffers, largest.size());
+    std::partial_sort(largest.begin(), largest.begin() + n, largest.end(),
+                      [](const MemoryUsageEntry& a, const MemoryUsageEntry& b) {
+                          return a.capacity_bytes > b.capacity_bytes;
+                      });
+    std::cout << "  Largest buffers:" << std::endl;
+    for (size_t i = 0; i < n; ++i) {
+        const auto& entry = largest[i];
+        std::cout << "    " << entry.owner << " / " << entry.category << " / " << entry.name << ": "
+                  << toMB(entry.capacity_bytes) << " MB" << std::endl;
+    }
+}
+
+void MemoryAccountant::writeJson(std::ostream& os) const {
+    os << "{\n";
+    os << "    \"peak_timeframe\": " << peak_timeframe_ << ",\n";
+    os << "    \"peak_accounted_bytes\": " << peak_capacity_bytes_ << ",\n";
+    os << "    \"rss_at_peak_bytes\": " << peak_rss_bytes_ << ",\n";
+    os << "    \"buffers\": [\n";
+    for (size_t i = 0; i < peak_usage_.size(); ++i) {
+        const auto& entry = peak_usage_[i];
+        os << "      {\"owner\": \"" << memory_accounting::jsonEscape(entry.owner) << "\""
+           << ", \"category\": \"" << memory_accounting::jsonEscape(entry.category) << "\""
+           << ", \"name\": \"" << memory_accounting::jsonEscape(entry.name) << "\""
+           << ", \"size_bytes\": " << entry.size_bytes
+           << ", \"capacity_bytes\": " << entry.capacity_bytes
+           << "}" << (i + 1 < peak_usage_.size() ? "," : "") << "\n";
+    }
+    os << "    ]\n";
+    os << "  }";
+}
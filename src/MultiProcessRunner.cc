@@ -0,0 +1,164 @@
+#include "MultiProcessRunner.h"
+#include "TimeframeBuilder.h"
+#include "TimeframeConcat.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+// Insert ".shardK" before the extension, so the shard keeps the output format
+// (e.g. out.edm4hep.root -> out.shard3.edm4hep.root)
+std::string shardFileName(const std::string& output_file, size_t index) {
+    std::filesystem::path path(output_file);
+    const std::string name = path.filename().string();
+    const size_t dot = name.find('.');
+    const std::string stem = name.substr(0, dot);
+    const std::string extension = dot == std::string::npos ? "" : name.substr(dot);
+    path.replace_filename(stem + ".shard" + std::to_string(index) + extension);
+    return path.string();
+}
+} // namespace
+
+MultiProcessRunner::MultiProcessRunner(const MergerConfig& config) : config_(config) {}
+
+MergerConfig MultiProcessRunner::workerConfig(size_t index, size_t n_workers, size_t first_timeframe,
+                                              size_t timeframes, unsigned int seed) const {
+    MergerConfig config = config_;
+    config.processes = 0;
+    config.max_events = timeframes;
+    config.first_timeframe = config_.first_timeframe + first_timeframe;
+    config.random_seed = seed;
+    config.output_file = shardFileName(config_.output_file, index);
+    for (auto& source : config.sources) {
+        source.entry_part = index;
+        source.entry_parts = n_workers;
+    }
+
+    // Per-worker reports next to the requested ones
+    const std::string suffix = ".worker" + std::to_string(index);
+    if (!config.report_file.empty()) {
+        config.report_file += suffix;
+    }
+    if (!config.memory_timeseries_file.empty()) {
+        config.memory_timeseries_file += suffix;
+    }
+    return config;
+}
+
+int MultiProcessRunner::runWorker(const Worker& worker) {
+    int log_fd = open(worker.log_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (log_fd >= 0) {
+        dup2(log_fd, STDOUT_FILENO);
+        dup2(log_fd, STDERR_FILENO);
+        close(log_fd);
+    }
+
+    int exit_code = 0;
+    try {
+        TimeframeBuilder merger(worker.config);
+        merger.setDataHandler(DataHandler::create(worker.config.output_file, worker.config.sources));
+        merger.run();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        exit_code = 1;
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    return exit_code;
+}
+
+void MultiProcessRunner::run() {
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    // More workers than timeframes would write empty shards
+    const size_t n_workers = std::max<size_t>(1, std::min<size_t>(config_.processes, config_.max_events));
+
+    // Worker seeds derived from the run seed, so a seeded run is reproducible
+    unsigned int base_seed = config_.random_seed == 0 ? std::random_device{}() : config_.random_seed;
+    std::seed_seq seed_sequence{base_seed};
+    std::vector<std::uint32_t> seeds(n_workers);
+    seed_sequence.generate(seeds.begin(), seeds.end());
+
+    std::vector<Worker> workers(n_workers);
+    size_t first_timeframe = 0;
+    for (size_t index = 0; index < n_workers; ++index) {
+        const size_t timeframes = config_.max_events / n_workers + (index < config_.max_events % n_workers ? 1 : 0);
+        // Seed 0 would fall back to random_device in the worker
+        const unsigned int seed = seeds[index] == 0 ? 1 : seeds[index];
+        auto& worker = workers[index];
+        worker.config = workerConfig(index, n_workers, first_timeframe, timeframes, seed);
+        worker.log_file = worker.config.output_file + ".log";
+        first_timeframe += timeframes;
+    }
+
+    std::cout << "Starting " << n_workers << " worker processes (base seed " << base_seed << ")" << std::endl;
+    for (size_t index = 0; index < n_workers; ++index) {
+        auto& worker = workers[index];
+        std::cout << "  Worker " << index << ": timeframes " << worker.config.first_timeframe << " to "
+                  << worker.config.first_timeframe + worker.config.max_events << ", seed "
+                  << worker.config.random_seed << ", output " << worker.config.output_file
+                  << ", log " << worker.log_file << std::endl;
+
+        // Flush first, the child inherits the stream buffers
+        std::cout.flush();
+        std::cerr.flush();
+        worker.pid = fork();
+        if (worker.pid == 0) {
+            // Skip the parent's exit handlers; the worker closed its output in finalize
+            _exit(runWorker(worker));
+        }
+        if (worker.pid < 0) {
+            const std::string error = std::strerror(errno);
+            for (size_t started = 0; started < index; ++started) {
+                kill(workers[started].pid, SIGTERM);
+                waitpid(workers[started].pid, nullptr, 0);
+            }
+            throw std::runtime_error("Cannot fork worker process " + std::to_string(index) + ": " + error);
+        }
+    }
+
+    size_t failed = 0;
+    for (size_t index = 0; index < n_workers; ++index) {
+        int status = 0;
+        if (waitpid(workers[index].pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "Worker " << index << " failed, see " << workers[index].log_file << std::endl;
+            ++failed;
+        } else {
+            std::cout << "Worker " << index << " finished" << std::endl;
+        }
+    }
+
+    std::vector<std::string> shard_files;
+    for (const auto& worker : workers) {
+        shard_files.push_back(worker.config.output_file);
+    }
+    if (failed > 0) {
+        for (const auto& shard_file : shard_files) {
+            std::filesystem::remove(shard_file);
+        }
+        throw std::runtime_error(std::to_string(failed) + " of " + std::to_string(n_workers) +
+                                 " worker processes failed");
+    }
+
+    // The workers numbered their timeframes from disjoint first_timeframe values already
+    timeframe_concat::concatenate(shard_files, config_.output_file, false);
+    for (const auto& worker : workers) {
+        std::filesystem::remove(worker.config.output_file);
+        std::filesystem::remove(worker.log_file);
+    }
+
+    double total_time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+    std::cout << "Merging complete with " << n_workers << " worker processes in " << total_time << " s" << std::endl;
+    std::cout << "Output saved to: " << config_.output_file << std::endl;
+}
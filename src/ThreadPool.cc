@@ -0,0 +1,79 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t n_threads) {
+    for (size_t i = 1; i < n_threads; ++i) {
+        workers_.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t n_tasks, const std::function<void(size_t)>& task) {
+    if (n_tasks == 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        n_tasks_ = n_tasks;
+        next_task_ = 0;
+        error_ = nullptr;
+        busy_workers_ = workers_.size();
+        ++generation_;
+    }
+    work_cv_.notify_all();
+
+    // The caller works too instead of waiting idle
+    runTasks();
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this] { return busy_workers_ == 0; });
+        task_ = nullptr;
+        error = error_;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::runTasks() {
+    for (size_t i = next_task_++; i < n_tasks_; i = next_task_++) {
+        try {
+            (*task_)(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    size_t seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+            if (stopping_) return;
+            seen_generation = generation_;
+        }
+        runTasks();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_workers_ == 0) {
+                done_cv_.notify_one();
+            }
+        }
+    }
+}
@@ -1,8 +1,20 @@
 #include "TimeframeBuilder.h"
 
+#include <TROOT.h>
 #include <iostream>
+#include <fstream>
 #include <stdexcept>
 #include <chrono>
+#include <filesystem>
+#include <sys/resource.h>
+
+namespace {
+using Clock = std::chrono::high_resolution_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+} // namespace
 
 TimeframeBuilder::TimeframeBuilder(const MergerConfig& config)
     : m_config(config), gen(config.random_seed == 0 ? rd() : config.random_seed) {}
@@ -22,70 +34,154 @@ void TimeframeBuilder::run() {
         throw std::runtime_error("No data handler set - call setDataHandler() before run()");
     }
 
+    if (m_config.n_threads > 0) {
+        ROOT::EnableImplicitMT(m_config.n_threads);
+        std::cout << "ROOT implicit multi-threading enabled with " << m_config.n_threads << " threads" << std::endl;
+    }
+
+    StageTimes stages;
+
     // Initialize data sources via the data handler
     // The data handler creates appropriate data sources for its format
+    auto stage_start = Clock::now();
+    data_handler_->setConfig(m_config);
     data_sources_ = data_handler_->initializeDataSources(m_config.output_file, m_config.sources);
+    stages.initialize = secondsSince(stage_start);
+
+    const size_t multiplex = m_config.signal_multiplex;
+    if (multiplex > 1) {
+        splitSignalSources();
+    }
+
+    if (!m_config.memory_timeseries_file.empty()) {
+        memory_accountant_.openTimeSeries(m_config.memory_timeseries_file);
+    }
 
     std::cout << "Processing " << m_config.max_events << " timeframes..." << std::endl;
 
     // Timing start
-    auto start_time = std::chrono::high_resolution_clock::now();
+    auto start_time = Clock::now();
     size_t events_generated = 0;
+    size_t events_merged = 0;
     for (; events_generated < m_config.max_events; ++events_generated) {
+        // A new background timeframe every multiplex timeframes, overlaid with new signal events in each
+        const bool new_background = multiplex <= 1 || events_generated % multiplex == 0;
+
         // Update number of events needed per source
-        if (!updateInputNEvents(data_sources_)) {
+        stage_start = Clock::now();
+        bool more_entries = true;
+        if (multiplex <= 1) {
+            more_entries = updateInputNEvents(data_sources_);
+        } else {
+            more_entries = (!new_background || updateInputNEvents(background_sources_)) &&
+                           updateInputNEvents(signal_sources_);
+        }
+        stages.sample += secondsSince(stage_start);
+        if (!more_entries) {
             std::cout << "Reached end of input data, stopping at " << events_generated
                       << " timeframes" << std::endl;
             break;
         }
 
         // Prepare for new timeframe
-        data_handler_->prepareTimeframe();
+        stage_start = Clock::now();
+        if (new_background) {
+            data_handler_->prepareTimeframe();
+        } else {
+            data_handler_->restoreBackground();
+        }
+        stages.prepare += secondsSince(stage_start);
 
         // Merge events from all sources
-        data_handler_->mergeEvents(
-            data_sources_, events_generated, m_config.timeframe_duration,
-            m_config.bunch_crossing_period, gen);
+        stage_start = Clock::now();
+        const size_t timeframe_number = m_config.first_timeframe + events_generated;
+        if (multiplex <= 1) {
+            events_merged += data_handler_->mergeEvents(
+                data_sources_, timeframe_number, m_config.timeframe_duration,
+                m_config.bunch_crossing_period, gen);
+        } else {
+            if (new_background) {
+                events_merged += data_handler_->mergeEvents(
+                    background_sources_, timeframe_number, m_config.timeframe_duration,
+                    m_config.bunch_crossing_period, gen);
+                data_handler_->saveBackground();
+            }
+            events_merged += data_handler_->mergeEvents(
+                signal_sources_, timeframe_number, m_config.timeframe_duration,
+                m_config.bunch_crossing_period, gen);
+        }
+        stages.merge += secondsSince(stage_start);
 
         // Write the timeframe
+        stage_start = Clock::now();
         data_handler_->writeTimeframe();
+        stages.write += secondsSince(stage_start);
+
+        if (memoryAccountingEnabled()) {
+            recordMemoryUsage(events_generated);
+        }
 
         if (events_generated % 10 == 0) {
             std::cout << "Processed " << events_generated << " timeframes..." << std::endl;
         }
     }
     // Timing end
-    auto end_time = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> elapsed = end_time - start_time;
-    double total_time = elapsed.count();
+    double total_time = secondsSince(start_time);
     double avg_time_per_event = (events_generated > 0) ? total_time / events_generated : 0.0;
+
+    // Finalize output
+    stage_start = Clock::now();
+    data_handler_->finalize();
+    stages.finalize = secondsSince(stage_start);
+
     std::cout << "\nTiming report:" << std::endl;
     std::cout << "  Total time: " << total_time << " s" << std::endl;
     std::cout << "  Number of events: " << events_generated << std::endl;
     std::cout << "  Average time per event: " << avg_time_per_event << " s" << std::endl;
+    std::cout << "  Stage breakdown:" << std::endl;
+    std::cout << "    Initialize: " << stages.initialize << " s" << std::endl;
+    std::cout << "    Sample:     " << stages.sample << " s" << std::endl;
+    std::cout << "    Prepare:    " << stages.prepare << " s" << std::endl;
+    std::cout << "    Merge:      " << stages.merge << " s" << std::endl;
+    std::cout << "    Write:      " << stages.write << " s" << std::endl;
+    std::cout << "    Finalize:   " << stages.finalize << " s" << std::endl;
 
-    // Finalize output
-    data_handler_->finalize();
+    if (memoryAccountingEnabled() && events_generated > 0) {
+        memory_accountant_.printSummary();
+    }
+
+    if (!m_config.report_file.empty()) {
+        writeRunReport(stages, events_generated, events_merged, total_time);
+    }
 
     std::cout << "Merging complete. Total timeframes processed: " << events_generated << std::endl;
     std::cout << "Output saved to: " << m_config.output_file << std::endl;
 }
 
 bool TimeframeBuilder::updateInputNEvents(std::vector<std::unique_ptr<DataSource>>& sources) {
+    // Whole bundles of the entries drawn for a bundled source, read by its bundles source next
+    size_t pending_bundles = 0;
     for (auto& data_source : sources) {
         const auto& config = data_source->getConfig();
 
         // Generate new number of events needed for this source
         if (config.already_merged) {
             // Already merged sources should only contribute 1 event (which is already a full timeframe)
-            data_source->setEntriesNeeded(1);
-        } else if (config.static_number_of_events) {
-            data_source->setEntriesNeeded(config.static_events_per_timeframe);
+            data_source->setEntriesNeeded(config.bundle_size > 0 ? pending_bundles : 1);
         } else {
-            // Use Poisson for this source
-            float mean_freq = config.mean_event_frequency;
-            std::poisson_distribution<> poisson_dist(m_config.timeframe_duration * mean_freq);
-            size_t n = poisson_dist(gen);
+            size_t n = 0;
+            if (config.static_number_of_events) {
+                n = config.static_events_per_timeframe;
+            } else {
+                // Use Poisson for this source
+                float mean_freq = config.mean_event_frequency;
+                std::poisson_distribution<> poisson_dist(m_config.timeframe_duration * mean_freq);
+                n = poisson_dist(gen);
+            }
+            if (config.bundle_size > 0) {
+                pending_bundles = n / config.bundle_size;
+                n %= config.bundle_size;
+            }
             data_source->setEntriesNeeded(n);
         }
 
@@ -97,4 +193,100 @@ bool TimeframeBuilder::updateInputNEvents(std::vector<std::unique_ptr<DataSource
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+void TimeframeBuilder::splitSignalSources() {
+    if (!data_handler_->supportsSignalMultiplex()) {
+        throw std::runtime_error("signal_multiplex is not supported by the " + data_handler_->getFormatName() +
+                                 " data handler");
+    }
+    for (auto& source : data_sources_) {
+        auto& target = source->getConfig().is_signal ? signal_sources_ : background_sources_;
+        target.push_back(std::move(source));
+    }
+    data_sources_.clear();
+    if (signal_sources_.empty()) {
+        throw std::runtime_error("signal_multiplex needs at least one source with is_signal set");
+    }
+    std::cout << "Signal multiplexing: " << background_sources_.size() << " background and "
+              << signal_sources_.size() << " signal sources, " << m_config.signal_multiplex
+              << " timeframes per background timeframe" << std::endl;
+}
+
+bool TimeframeBuilder::memoryAccountingEnabled() const {
+    return m_config.memory_accounting || !m_config.memory_timeseries_file.empty();
+}
+
+void TimeframeBuilder::recordMemoryUsage(size_t timeframe) {
+    MemoryUsage usage;
+    data_handler_->collectMemoryUsage(usage);
+    for (const auto* sources : {&data_sources_, &background_sources_, &signal_sources_}) {
+        for (const auto& source : *sources) {
+            source->collectMemoryUsage(usage);
+        }
+    }
+    memory_accountant_.record(timeframe, std::move(usage));
+}
+
+void TimeframeBuilder::writeRunReport(const StageTimes& stages, size_t timeframes, size_t events, double total_time) const {
+    std::error_code ec;
+    auto output_bytes = std::filesystem::file_size(m_config.output_file, ec);
+    if (ec) output_bytes = 0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double peak_rss_mb = usage.ru_maxrss / 1024.0;  // ru_maxrss is in kB on Linux
+
+    double output_mb = output_bytes / (1024.0 * 1024.0);
+    double timeframes_per_s = total_time > 0.0 ? timeframes / total_time : 0.0;
+    double events_per_s = total_time > 0.0 ? events / total_time : 0.0;
+    double output_mb_per_s = total_time > 0.0 ? output_mb / total_time : 0.0;
+
+    std::ofstream report(m_config.report_file);
+    if (!report) {
+        std::cerr << "Warning: Could not write run report to " << m_config.report_file << std::endl;
+        return;
+    }
+
+    report << "{\n";
+    report << "  \"output_file\": \"" << memory_accounting::jsonEscape(m_config.output_file) << "\",\n";
+    report << "  \"timeframe_duration\": " << m_config.timeframe_duration << ",\n";
+    report << "  \"bunch_crossing_period\": " << m_config.bunch_crossing_period << ",\n";
+    report << "  \"n_threads\": " << m_config.n_threads << ",\n";
+    report << "  \"compression_algorithm\": \"" << memory_accounting::jsonEscape(m_config.compression_algorithm) << "\",\n";
+    report << "  \"compression_level\": " << m_config.compression_level << ",\n";
+    report << "  \"sources\": [\n";
+    for (size_t i = 0; i < m_config.sources.size(); ++i) {
+        const auto& source = m_config.sources[i];
+        report << "    {\"name\": \"" << memory_accounting::jsonEscape(source.name) << "\""
+               << ", \"mean_event_frequency\": " << source.mean_event_frequency
+               << ", \"static_number_of_events\": " << (source.static_number_of_events ? "true" : "false")
+               << ", \"static_events_per_timeframe\": " << source.static_events_per_timeframe
+               << "}" << (i + 1 < m_config.sources.size() ? "," : "") << "\n";
+    }
+    report << "  ],\n";
+    report << "  \"timeframes\": " << timeframes << ",\n";
+    report << "  \"events\": " << events << ",\n";
+    report << "  \"total_time_s\": " << total_time << ",\n";
+    report << "  \"timeframes_per_s\": " << timeframes_per_s << ",\n";
+    report << "  \"events_per_s\": " << events_per_s << ",\n";
+    report << "  \"output_bytes\": " << output_bytes << ",\n";
+    report << "  \"output_mb_per_s\": " << output_mb_per_s << ",\n";
+    report << "  \"peak_rss_mb\": " << peak_rss_mb << ",\n";
+    report << "  \"stages_s\": {\n";
+    report << "    \"initialize\": " << stages.initialize << ",\n";
+    report << "    \"sample\": " << stages.sample << ",\n";
+    report << "    \"prepare\": " << stages.prepare << ",\n";
+    report << "    \"merge\": " << stages.merge << ",\n";
+    report << "    \"write\": " << stages.write << ",\n";
+    report << "    \"finalize\": " << stages.finalize << "\n";
+    report << "  }";
+    if (memoryAccountingEnabled() && timeframes > 0) {
+        report << ",\n  \"memory\": ";
+        memory_accountant_.writeJson(report);
+    }
+    report << "\n";
+    report << "}\n";
+
+    std::cout << "Run report written to: " << m_config.report_file << std::endl;
+}
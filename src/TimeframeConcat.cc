@@ -0,0 +1,144 @@
+#include "TimeframeConcat.h"
+
+#include <edm4hep/EventHeaderData.h>
+#include <TBranch.h>
+#include <TChain.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+namespace timeframe_concat {
+
+namespace {
+// Timeframe trees written by the EDM4hep and HepMC3 output handlers
+const std::vector<std::string> kTimeframeTrees = {"events", "hepmc3_tree"};
+
+const std::vector<std::string> kMetadataTrees = {"podio_metadata", "runs", "meta", "metadata"};
+
+const char* kEventHeaderBranch = "EventHeader";
+
+// Fill the EventHeader branch of output_tree with eventNumber and timeStamp set to the
+// output entry, reading the other header fields through a chain of its own
+void refillEventHeaders(const std::vector<std::string>& input_files, const std::string& tree_name,
+                        TTree* output_tree) {
+    TChain header_chain(tree_name.c_str());
+    for (const auto& input_file : input_files) {
+        header_chain.Add(input_file.c_str(), 0);
+    }
+    header_chain.SetBranchStatus("*", false);
+    header_chain.SetBranchStatus("EventHeader*", true);
+
+    std::vector<edm4hep::EventHeaderData>* input_headers = nullptr;
+    header_chain.SetBranchAddress(kEventHeaderBranch, &input_headers);
+
+    std::vector<edm4hep::EventHeaderData> headers;
+    TBranch* branch = output_tree->Branch(kEventHeaderBranch, &headers);
+
+    const Long64_t entries = header_chain.GetEntries();
+    for (Long64_t entry = 0; entry < entries; ++entry) {
+        if (header_chain.GetEntry(entry) <= 0) {
+            throw std::runtime_error("Cannot read EventHeader of timeframe " + std::to_string(entry));
+        }
+        headers = *input_headers;
+        for (auto& header : headers) {
+            header.eventNumber = static_cast<int32_t>(entry);
+            header.timeStamp = static_cast<uint64_t>(entry);
+        }
+        branch->Fill();
+    }
+    header_chain.ResetBranchAddresses();
+    delete input_headers;
+}
+} // namespace
+
+size_t copyMetadataTrees(TFile& source, TFile& output) {
+    size_t copied = 0;
+    for (const auto& name : kMetadataTrees) {
+        TTree* metadata_tree = dynamic_cast<TTree*>(source.Get(name.c_str()));
+        if (!metadata_tree) continue;
+        output.cd();
+        TTree* output_metadata = metadata_tree->CloneTree(-1, "fast");
+        if (!output_metadata) {
+            std::cout << "Warning: Failed to clone metadata tree " << name << " from " << source.GetName() << std::endl;
+            continue;
+        }
+        output_metadata->SetDirectory(&output);
+        std::cout << "Copied metadata tree " << name << " with " << output_metadata->GetEntries()
+                  << " entries from " << source.GetName() << std::endl;
+        ++copied;
+    }
+    return copied;
+}
+
+size_t concatenate(const std::vector<std::string>& input_files, const std::string& output_file,
+                   bool renumber_headers) {
+    if (input_files.empty()) {
+        throw std::runtime_error("No input files to concatenate into " + output_file);
+    }
+
+    auto first_file = std::unique_ptr<TFile>{TFile::Open(input_files[0].c_str(), "READ")};
+    if (!first_file || first_file->IsZombie()) {
+        throw std::runtime_error("Cannot open " + input_files[0]);
+    }
+    std::string tree_name;
+    TTree* first_tree = nullptr;
+    for (const auto& name : kTimeframeTrees) {
+        first_tree = first_file->Get<TTree>(name.c_str());
+        if (first_tree) {
+            tree_name = name;
+            break;
+        }
+    }
+    if (tree_name.empty()) {
+        throw std::runtime_error("No timeframe tree in " + input_files[0]);
+    }
+    // HepMC3 trees carry the event number inside hepmc3_event, which is copied as is
+    renumber_headers = renumber_headers && first_tree->GetBranch(kEventHeaderBranch);
+
+    TChain chain(tree_name.c_str());
+    for (const auto& input_file : input_files) {
+        if (chain.Add(input_file.c_str(), 0) == 0) {
+            throw std::runtime_error("Cannot read " + tree_name + " from " + input_file);
+        }
+    }
+    if (renumber_headers) {
+        // Disabled branches are not cloned
+        chain.SetBranchStatus("EventHeader*", false);
+    }
+
+    // Fast cloning copies the compressed baskets as they are, so the output uses the
+    // settings the baskets were written with
+    auto output = std::make_unique<TFile>(output_file.c_str(), "RECREATE", "", first_file->GetCompressionSettings());
+    if (output->IsZombie()) {
+        throw std::runtime_error("Cannot create output file: " + output_file);
+    }
+    output->cd();
+
+    TTree* output_tree = chain.CloneTree(0);
+    if (!output_tree) {
+        throw std::runtime_error("Cannot clone " + tree_name + " from " + input_files[0]);
+    }
+    output_tree->SetDirectory(output.get());
+    if (output_tree->CopyEntries(&chain, -1, "fast") < 0) {
+        throw std::runtime_error("Fast copy of " + tree_name + " into " + output_file + " failed");
+    }
+    const size_t timeframes = static_cast<size_t>(output_tree->GetEntries());
+    std::cout << "Concatenated " << timeframes << " timeframes from " << input_files.size()
+              << " files into " << output_file << std::endl;
+
+    if (renumber_headers) {
+        refillEventHeaders(input_files, tree_name, output_tree);
+        std::cout << "Renumbered EventHeader of " << timeframes << " timeframes" << std::endl;
+    }
+
+    copyMetadataTrees(*first_file, *output);
+
+    output->Write();
+    output->Close();
+    first_file->Close();
+    return timeframes;
+}
+
+} // namespace timeframe_concat
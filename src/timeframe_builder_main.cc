@@ -1,6 +1,7 @@
 #include "TimeframeBuilder.h"
 #include "DataHandler.h"
 #include "CommandLineParser.h"
+#include "MultiProcessRunner.h"
 #include <iostream>
 #include <exception>
 
@@ -9,11 +10,19 @@ int main(int argc, char* argv[]) {
         // Parse command-line arguments and YAML configuration
         MergerConfig config = CommandLineParser::parse(argc, argv);
         
+        // Fork workers before any ROOT state exists and concatenate their shards
+        if (config.processes > 1) {
+            MultiProcessRunner runner(config);
+            runner.run();
+            std::cout << "Successfully completed timeframe merging!" << std::endl;
+            return 0;
+        }
+        
         // Create the merger
         TimeframeBuilder merger(config);
         
-        // Create appropriate data handler based on output file extension
-        auto data_handler = DataHandler::create(config.output_file);
+        // Create appropriate data handler based on output file extension and input format
+        auto data_handler = DataHandler::create(config.output_file, config.sources);
         merger.setDataHandler(std::move(data_handler));
         
         // Run the merger
@@ -0,0 +1,67 @@
+#include "TimeframeConcat.h"
+#include <chrono>
+#include <exception>
+#include <getopt.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+void printUsage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options] -o OUTPUT input_file1 [input_file2 ...]\n"
+              << "\nConcatenate timeframe files by copying their compressed baskets.\n"
+              << "\nOptions:\n"
+              << "  -o, --output FILE           Output file name (required)\n"
+              << "  --keep-event-numbers        Copy EventHeader as is instead of renumbering the timeframes\n"
+              << "  -h, --help                  Show this help message\n";
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        std::string output_file;
+        bool renumber_headers = true;
+
+        static struct option long_options[] = {
+            {"output", required_argument, 0, 'o'},
+            {"keep-event-numbers", no_argument, 0, 1000},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0}
+        };
+
+        int opt;
+        int option_index = 0;
+        while ((opt = getopt_long(argc, argv, "o:h", long_options, &option_index)) != -1) {
+            switch (opt) {
+                case 'o':
+                    output_file = optarg;
+                    break;
+                case 1000:
+                    renumber_headers = false;
+                    break;
+                case 'h':
+                    printUsage(argv[0]);
+                    return 0;
+                default:
+                    printUsage(argv[0]);
+                    return 1;
+            }
+        }
+
+        std::vector<std::string> input_files(argv + optind, argv + argc);
+        if (output_file.empty() || input_files.empty()) {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        size_t timeframes = timeframe_concat::concatenate(input_files, output_file, renumber_headers);
+        double total_time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+        std::cout << "Wrote " << timeframes << " timeframes to " << output_file << " in " << total_time << " s" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}